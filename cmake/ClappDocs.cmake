@@ -0,0 +1,71 @@
+# Build-time documentation of clapp options.
+#
+# clapp_generate_docs(<target>
+#     DEFINITIONS <source>...
+#     [PROGRAM <name>]
+#     [SECTION <section>])
+#
+# The DEFINITIONS sources define
+#
+#     void clappDefineOptions(clapp::ArgumentParser& parser);
+#
+# which registers the options of <target> and sets its name, description and
+# version. <target> calls the same function on its own parser. A generator
+# built from these sources writes into <target>_docs in the current binary
+# directory:
+#
+#     <target>_help.hpp      clapp_docs::help and clapp_docs::fingerprint, the
+#                            helpFingerprint(), for
+#                            ArgumentParser::prerenderedHelp()
+#     <target>.<section>     roff man page
+#     <target>.md            Markdown
+#
+# The directory is added to the include path of <target>. PROGRAM is the name
+# in the usage line and defaults to <target>, SECTION defaults to 1. The
+# generator runs on the build host.
+
+set(CLAPP_DOCGEN_SOURCE ${CMAKE_CURRENT_LIST_DIR}/../tools/clapp_docgen.cpp
+    CACHE INTERNAL "Source of the clapp_generate_docs() generator")
+
+function(clapp_generate_docs target)
+    cmake_parse_arguments(DOCS "" "PROGRAM;SECTION" "DEFINITIONS" ${ARGN})
+    if(NOT DOCS_DEFINITIONS)
+        message(FATAL_ERROR "clapp_generate_docs(${target}) needs DEFINITIONS")
+    endif()
+    if(NOT DOCS_PROGRAM)
+        set(DOCS_PROGRAM ${target})
+    endif()
+    if(NOT DOCS_SECTION)
+        set(DOCS_SECTION 1)
+    endif()
+
+    set(generator ${target}_docgen)
+    add_executable(${generator}
+        ${CLAPP_DOCGEN_SOURCE}
+        ${DOCS_DEFINITIONS})
+    target_link_libraries(${generator} PRIVATE
+        clapp)
+
+    set(directory ${CMAKE_CURRENT_BINARY_DIR}/${target}_docs)
+    set(header ${directory}/${target}_help.hpp)
+    set(man ${directory}/${target}.${DOCS_SECTION})
+    set(markdown ${directory}/${target}.md)
+    add_custom_command(
+        OUTPUT ${header} ${man} ${markdown}
+        COMMAND ${CMAKE_COMMAND} -E make_directory ${directory}
+        COMMAND ${generator}
+            --program ${DOCS_PROGRAM}
+            --header ${header}
+            --man ${man}
+            --section ${DOCS_SECTION}
+            --markdown ${markdown}
+        DEPENDS ${generator}
+        COMMENT "Generating documentation of ${target}"
+        VERBATIM)
+    add_custom_target(${target}_docs
+        DEPENDS ${header} ${man} ${markdown})
+
+    add_dependencies(${target} ${target}_docs)
+    target_include_directories(${target} PRIVATE
+        ${directory})
+endfunction()
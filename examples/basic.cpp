@@ -18,7 +18,7 @@ int main(int argc, char* argv[])
     parser.option("-v", "--version")
         .flag()
         .overruling()
-        .callback([](auto val) {
+        .callback([](bool) {
             std::cout << "1.0" << std::endl;
         });
 
@@ -31,825 +31,5221 @@ ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 DEALINGS IN THE SOFTWARE.
 */
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <memory>
+#include <new>
 #include <optional>
 #include <set>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <system_error>
 #include <tuple>
-#include <unordered_map>
+#include <type_traits>
+#include <typeinfo>
 #include <utility>
 #include <vector>
 
-#define CLAPP_VERSION_MAJOR 1
-#define CLAPP_VERSION_MINOR 4
-#define CLAPP_VERSION_PATCH 1
+#define CLAPP_VERSION_MAJOR 2
+#define CLAPP_VERSION_MINOR 0
+#define CLAPP_VERSION_PATCH 0
+
+// Parallel callbacks and prefetching on a helper thread need the threads
+// library, they are only available if CLAPP_ENABLE_THREADS is defined.
+#ifdef CLAPP_ENABLE_THREADS
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+// <regex> is costly to compile, pattern() validators are only available if
+// CLAPP_ENABLE_REGEX is defined.
+#ifdef CLAPP_ENABLE_REGEX
+#include <regex>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CLAPP_HAS_MMAP 1
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// USDT probes of the provider "clapp" for perf and bpftrace. A nop when no
+// tracer is attached, compiled out unless CLAPP_ENABLE_USDT is defined. Every
+// parse__start is followed by parse__end, with success 0 if parsing throws,
+// and callback__exit also fires if the callback throws.
+//   parse__start(options)            parse__end(success)
+//   option__match(option, argument)  convert(option, text, size)
+//   validation__failure(option, ErrorKind, None for constraints)
+//   callback__entry(option)          callback__exit(option)
+#ifdef CLAPP_ENABLE_USDT
+#if defined(__has_include) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define CLAPP_PROBE(name, ...) STAP_PROBEV(clapp, name, ##__VA_ARGS__)
+#else
+#error "CLAPP_ENABLE_USDT requires <sys/sdt.h> (systemtap-sdt-dev)."
+#endif
+#else
+#define CLAPP_PROBE(name, ...) ((void)0)
+#endif
 
 namespace clapp
 {
 
 /* Type conversions */
 
+// The TypeParser templates of the library are marked as builtin, so that
+// specializations provided by users take precedence over parseValue().
+
 template <typename T> struct TypeParser
 {
+    static constexpr bool builtin = true;
     static T Get(std::string value) { return T{value}; }
 };
 
 template <> struct TypeParser<int>
 {
+    static constexpr bool builtin = true;
     static int Get(const std::string& value) { return std::stoi(value); }
 };
 
 template <> struct TypeParser<double>
 {
+    static constexpr bool builtin = true;
     static double Get(const std::string& value) { return std::stod(value); }
 };
 
 template <> struct TypeParser<float>
 {
+    static constexpr bool builtin = true;
     static float Get(const std::string& value) { return std::stof(value); }
 };
 
 template <> struct TypeParser<bool>
 {
+    static constexpr bool builtin = true;
     static bool Get(const std::string& value)
     {
         return value.empty() || value == "1" || value == "true";
     }
 };
 
-/* Argument parser */
+namespace detail
+{
 
-class ArgumentParser
+/**
+ * @brief Removes a leading '+' of a number. Returns false if it is followed
+ * by another sign.
+ *
+ */
+inline bool stripPlus(std::string_view& text)
 {
-public:
-    /**
-     * @brief Exception used for errors during the command line parsing. For
-     * example if an option is missing but required.
-     *
-     */
-    class ArgumentParserException : public std::runtime_error
+    if (!text.empty() && text.front() == '+')
     {
-    public:
-        explicit ArgumentParserException(const std::string& what)
-            : std::runtime_error(what)
+        text.remove_prefix(1);
+        return text.empty() || (text.front() != '-' && text.front() != '+');
+    }
+    return true;
+}
+
+} // namespace detail
+
+/**
+ * @brief Customization point for converting an argument to a T. Overload
+ * parseValue(std::string_view, T&) in the namespace of T (found by ADL);
+ * return a default constructed std::errc on success. Types without an
+ * overload are converted with TypeParser<T>, a specialization of TypeParser<T>
+ * takes precedence over parseValue().
+ *
+ */
+template <typename T>
+std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, std::errc>
+parseValue(std::string_view text, T& value)
+{
+    if (!detail::stripPlus(text))
+    {
+        return std::errc::invalid_argument;
+    }
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(),
+                                     value);
+    if (ec == std::errc{} && end != text.data() + text.size())
+    {
+        return std::errc::invalid_argument;
+    }
+    return ec;
+}
+
+template <typename T>
+std::enable_if_t<std::is_floating_point_v<T>, std::errc>
+parseValue(std::string_view text, T& value)
+{
+    if (!detail::stripPlus(text))
+    {
+        return std::errc::invalid_argument;
+    }
+#if defined(__cpp_lib_to_chars)
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(),
+                                     value);
+    if (ec == std::errc{} && end != text.data() + text.size())
+    {
+        return std::errc::invalid_argument;
+    }
+    return ec;
+#else
+    std::string buffer{text};
+    char* end = nullptr;
+    errno = 0;
+    auto result = std::strtold(buffer.c_str(), &end);
+    if (buffer.empty() || end != buffer.c_str() + buffer.size())
+    {
+        return std::errc::invalid_argument;
+    }
+    if (errno == ERANGE)
+    {
+        return std::errc::result_out_of_range;
+    }
+    value = static_cast<T>(result);
+    return {};
+#endif
+}
+
+inline std::errc parseValue(std::string_view text, bool& value)
+{
+    value = text.empty() || text == "1" || text == "true";
+    return {};
+}
+
+inline std::errc parseValue(std::string_view text, std::string& value)
+{
+    value.assign(text);
+    return {};
+}
+
+/**
+ * @brief The value views the argument, which must outlive it.
+ *
+ */
+inline std::errc parseValue(std::string_view text, std::string_view& value)
+{
+    value = text;
+    return {};
+}
+
+namespace detail
+{
+
+template <typename T, typename = void> struct HasParseValue : std::false_type
+{
+};
+
+template <typename T>
+struct HasParseValue<T, std::void_t<decltype(parseValue(
+                            std::declval<std::string_view>(),
+                            std::declval<T&>()))>> : std::true_type
+{
+};
+
+template <typename T, typename = void>
+struct HasBuiltinTypeParser : std::false_type
+{
+};
+
+template <typename T>
+struct HasBuiltinTypeParser<T, std::void_t<decltype(TypeParser<T>::builtin)>>
+    : std::true_type
+{
+};
+
+/**
+ * @brief Converts text into value with a user provided TypeParser<T> if there
+ * is one, with parseValue() if there is an overload for T and with the
+ * builtin TypeParser<T> otherwise.
+ *
+ */
+template <typename T> std::errc convert(std::string_view text, T& value)
+{
+    if constexpr (HasParseValue<T>::value && HasBuiltinTypeParser<T>::value)
+    {
+        return parseValue(text, value);
+    }
+    else
+    {
+        try
         {
+            value = TypeParser<T>::Get(std::string{text});
+            return {};
         }
-    };
+        catch (const std::invalid_argument&)
+        {
+            return std::errc::invalid_argument;
+        }
+        catch (const std::out_of_range&)
+        {
+            return std::errc::result_out_of_range;
+        }
+    }
+}
 
-    /**
-     * @brief Option class representing a command line option the user can
-     * specify. Use for internal purposes only.
-     *
-     */
-    struct Option
+} // namespace detail
+
+/* Snapshot encoding */
+
+/**
+ * @brief Binary encoding of option values used by ArgumentParser::snapshot()
+ * and ArgumentParser::restore(). Arithmetic types, enums and std::string are
+ * supported, specialize for custom types that should be part of a snapshot.
+ * decode() only validates the input if value is null.
+ *
+ */
+template <typename T, typename = void> struct ValueCodec
+{
+    static constexpr bool supported = false;
+};
+
+// only types without pointers can be copied bytewise
+template <typename T>
+struct ValueCodec<T, std::enable_if_t<std::is_arithmetic_v<T> ||
+                                      std::is_enum_v<T>>>
+{
+    static constexpr bool supported = true;
+
+    static void encode(const T& value, std::string& out)
     {
-        virtual ~Option() = default;
-        friend class ArgumentParser;
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
 
-    protected:
-        Option(std::string _short_option, std::string _long_option)
-            : short_option{std::move(_short_option)},
-              long_option{std::move(_long_option)}
+    static bool decode(std::string_view& in, T* value)
+    {
+        if (in.size() < sizeof(T))
         {
+            return false;
         }
-
-        explicit Option(const std::string& long_option)
-            : Option("", long_option)
+        if (value != nullptr)
         {
+            std::memcpy(value, in.data(), sizeof(T));
         }
+        in.remove_prefix(sizeof(T));
+        return true;
+    }
+};
 
-        virtual void setValue(const std::string& value) = 0;
-        [[nodiscard]] virtual bool isAllowedValue(const std::string& value) = 0;
-        [[nodiscard]] virtual bool isPositionalOption() const = 0;
-        virtual std::set<std::string> choices() = 0;
-        virtual void invokeCallback() = 0;
+template <> struct ValueCodec<std::string>
+{
+    static constexpr bool supported = true;
 
-        bool operator<(const Option& other) { return name() < other.name(); }
+    static void encode(const std::string& value, std::string& out)
+    {
+        ValueCodec<uint64_t>::encode(value.size(), out);
+        out.append(value);
+    }
 
-        [[nodiscard]] std::string name() const
+    static bool decode(std::string_view& in, std::string* value)
+    {
+        uint64_t size = 0;
+        if (!ValueCodec<uint64_t>::decode(in, &size) || in.size() < size)
         {
-            std::stringstream ss;
-            ss << short_option;
-            if (!long_option.empty())
-            {
-                ss << " (" << long_option << ")";
-            }
-            return ss.str();
+            return false;
+        }
+        if (value != nullptr)
+        {
+            value->assign(in.data(), size);
         }
+        in.remove_prefix(size);
+        return true;
+    }
+};
+
+namespace detail
+{
 
-        std::string argument_name;
-        std::string short_option;
-        std::string long_option;
-        std::string description;
+/**
+ * @brief 64 bit FNV-1a hash.
+ *
+ */
+inline uint64_t fnv1a(std::string_view data,
+                      uint64_t hash = 0xcbf29ce484222325ULL)
+{
+    for (char c : data)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
 
-        bool required = false;
-        bool set = false;
-        bool flag = false;
-        bool overruling = false;
-        bool has_default_value = false;
-    };
+/**
+ * @brief Read-only view of the contents of a file. The file is memory-mapped
+ * where the platform supports it and read into a buffer otherwise.
+ *
+ */
+class FileMapping
+{
+public:
+    FileMapping() = default;
+    FileMapping(const FileMapping&) = delete;
+    FileMapping& operator=(const FileMapping&) = delete;
+
+    FileMapping(FileMapping&& other) noexcept { swap(other); }
+
+    FileMapping& operator=(FileMapping&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            swap(other);
+        }
+        return *this;
+    }
+
+    ~FileMapping() { close(); }
 
     /**
-     * @brief Wrapper of an user specified option that can be interacted with.
-     * To configure the option use the public member functions of this class.
+     * @brief Maps the file at the given path. Returns false if the file
+     * cannot be opened or read.
      *
-     * @tparam T
      */
-    template <typename T> class OptionWrapper : public Option
+    bool open(const std::string& path)
     {
-    public:
-        OptionWrapper(const std::string& short_option,
-                      const std::string& long_option)
-            : Option(short_option, long_option)
+        close();
+#ifdef CLAPP_HAS_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
         {
+            return false;
         }
 
-        explicit OptionWrapper(const std::string& long_option)
-            : Option(long_option)
+        struct stat st
         {
+        };
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            ::close(fd);
+            return false;
         }
 
-        OptionWrapper(const OptionWrapper&) = delete;
-        ~OptionWrapper() override = default;
-
-        /**
-         * @brief Argument name.
-         *
-         * @param name Argument name displayed in the help message.
-         * @return OptionWrapper<T>&
-         */
-        OptionWrapper<T>& argument(const std::string& name)
+        m_size = static_cast<size_t>(st.st_size);
+        if (m_size > 0)
         {
-            Option::argument_name = name;
-            return *this;
+            void* addr =
+                ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED)
+            {
+                ::close(fd);
+                m_size = 0;
+                return false;
+            }
+            m_data = static_cast<const char*>(addr);
+            m_mapped = true;
         }
-
-        /**
-         * @brief Describes what the option does. Displayed in the help message.
-         *
-         * @param description Description of the option.
-         */
-        OptionWrapper<T>& description(const std::string& description)
+        ::close(fd);
+        return true;
+#else
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
         {
-            Option::description = description;
-            return *this;
+            return false;
         }
 
-        /**
-         * @brief Option must not be specified.
-         *
-         */
-        OptionWrapper<T>& optional()
+        m_size = static_cast<size_t>(file.tellg());
+        m_buffer = std::make_unique<char[]>(m_size);
+        file.seekg(0);
+        if (!file.read(m_buffer.get(), m_size))
         {
-            Option::required = false;
-            return *this;
+            close();
+            return false;
         }
+        m_data = m_buffer.get();
+        return true;
+#endif
+    }
 
-        /**
-         * @brief Option must be specified.
-         *
-         */
-        OptionWrapper<T>& required()
+    void close()
+    {
+#ifdef CLAPP_HAS_MMAP
+        if (m_mapped)
         {
-            Option::required = true;
-            return *this;
+            ::munmap(const_cast<char*>(m_data), m_size);
         }
+#endif
+        m_buffer.reset();
+        m_data = nullptr;
+        m_size = 0;
+        m_mapped = false;
+    }
 
-        /**
-         * @brief Where the value is stored if it is provided.
-         *
-         * @param store Storage
-         */
-        OptionWrapper<T>& store(T& store)
+    [[nodiscard]] std::string_view view() const { return {m_data, m_size}; }
+
+private:
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+    bool m_mapped = false;
+    std::unique_ptr<char[]> m_buffer;
+
+    void swap(FileMapping& other) noexcept
+    {
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        std::swap(m_mapped, other.m_mapped);
+        std::swap(m_buffer, other.m_buffer);
+    }
+};
+
+/**
+ * @brief Packed set of bits indexed by option. Operations between bitsets of
+ * different sizes treat missing bits as zero.
+ *
+ */
+class Bitset
+{
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    void resize(size_t bits) { m_words.resize((bits + 63) / 64); }
+    void clear() { std::fill(m_words.begin(), m_words.end(), 0); }
+
+    void set(size_t bit)
+    {
+        if (bit / 64 >= m_words.size())
         {
-            m_ref = &store;
-            *m_ref = m_value;
-            return *this;
+            resize(bit + 1);
         }
+        m_words[bit / 64] |= uint64_t{1} << (bit % 64);
+    }
 
-        /**
-         * @brief Function to be called if a value has been stored.
-         *
-         * @param callback Callback function
-         */
-        OptionWrapper<T>& callback(std::function<void(T)> callback)
+    void reset(size_t bit)
+    {
+        if (bit / 64 < m_words.size())
         {
-            m_callback = callback;
-            return *this;
+            m_words[bit / 64] &= ~(uint64_t{1} << (bit % 64));
         }
+    }
 
-        /**
-         * @brief Option has no arguments and is treated as a flag.
-         *
-         */
-        OptionWrapper<T>& flag()
+    [[nodiscard]] bool test(size_t bit) const
+    {
+        return bit / 64 < m_words.size() &&
+               ((m_words[bit / 64] >> (bit % 64)) & 1U);
+    }
+
+    [[nodiscard]] bool intersects(const Bitset& other) const
+    {
+        return find(other, false) != npos;
+    }
+
+    /**
+     * @brief Number of bits set in both bitsets.
+     *
+     */
+    [[nodiscard]] size_t countCommon(const Bitset& other) const
+    {
+        size_t count = 0;
+        auto words = std::min(m_words.size(), other.m_words.size());
+        for (size_t i = 0; i < words; ++i)
         {
-            Option::flag = true;
-            return *this;
+            for (auto word = m_words[i] & other.m_words[i]; word != 0;
+                 word &= word - 1)
+            {
+                ++count;
+            }
         }
+        return count;
+    }
 
-        /**
-         * @brief Default value if the option is not specified.
-         *
-         * @param value Some default value.
-         * @return OptionWrapper<T>&
-         */
-        OptionWrapper<T>& defaultValue(T value)
+    /**
+     * @brief Index of the first bit set in this bitset and in other (or not
+     * in other if inverted is true) starting at bit from. Returns npos if
+     * there is no such bit.
+     *
+     */
+    [[nodiscard]] size_t find(const Bitset& other, bool inverted,
+                              size_t from = 0) const
+    {
+        for (size_t i = from / 64; i < m_words.size(); ++i)
         {
-            Option::has_default_value = true;
-            m_value = value;
-            if (m_ref != nullptr)
+            uint64_t mask = i < other.m_words.size() ? other.m_words[i] : 0;
+            uint64_t word = m_words[i] & (inverted ? ~mask : mask);
+            if (i == from / 64)
             {
-                *m_ref = m_value;
+                word &= ~uint64_t{0} << (from % 64);
+            }
+            for (size_t bit = 0; word != 0; ++bit, word >>= 1)
+            {
+                if (word & 1U)
+                {
+                    return i * 64 + bit;
+                }
             }
-            return *this;
         }
+        return npos;
+    }
 
-        /**
-         * @brief This arguments stops the parsing and executes a specified
-         * callback.
-         *
-         * @return OptionWrapper<T>&
-         */
-        OptionWrapper<T>& overruling()
+    [[nodiscard]] const std::vector<uint64_t>& words() const { return m_words; }
+    std::vector<uint64_t>& words() { return m_words; }
+
+private:
+    std::vector<uint64_t> m_words;
+};
+
+template <typename T, typename = void>
+struct IsStreamable : std::false_type
+{
+};
+
+template <typename T>
+struct IsStreamable<T, std::void_t<decltype(std::declval<std::ostream&>()
+                                            << std::declval<const T&>())>>
+    : std::true_type
+{
+};
+
+template <typename T, typename = void>
+struct IsLessComparable : std::false_type
+{
+};
+
+template <typename T>
+struct IsLessComparable<T, std::void_t<decltype(std::declval<const T&>() <
+                                                std::declval<const T&>())>>
+    : std::true_type
+{
+};
+
+/**
+ * @brief Struct-of-arrays storage for option values. Values are stored per
+ * type in chunked columns, so adding a value never moves the values that are
+ * already stored. Options refer to their value by slot index.
+ *
+ */
+class ValueStorage
+{
+public:
+    template <typename T> using Container = std::deque<T>;
+
+    /**
+     * @brief Adds a value initialized slot for a T value and returns the
+     * container and the slot index.
+     *
+     */
+    template <typename T> std::pair<Container<T>*, size_t> add()
+    {
+        auto& values = pool<T>();
+        values.emplace_back();
+        return {&values, values.size() - 1};
+    }
+
+private:
+    struct PoolBase
+    {
+        virtual ~PoolBase() = default;
+    };
+
+    template <typename T> struct Pool : PoolBase
+    {
+        static constexpr char key = 0;
+        Container<T> values;
+    };
+
+    std::vector<std::pair<const void*, std::unique_ptr<PoolBase>>> m_pools;
+
+    template <typename T> Container<T>& pool()
+    {
+        for (auto& [key, pool] : m_pools)
+        {
+            if (key == &Pool<T>::key)
+            {
+                return static_cast<Pool<T>*>(pool.get())->values;
+            }
+        }
+        m_pools.emplace_back(&Pool<T>::key, std::make_unique<Pool<T>>());
+        return static_cast<Pool<T>*>(m_pools.back().second.get())->values;
+    }
+};
+
+/**
+ * @brief Open addressing hash table mapping option names to option indices.
+ * Keys are views into strings owned by the options, lookups do not allocate.
+ *
+ */
+class NameIndex
+{
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    void reserve(size_t names)
+    {
+        if (names * 2 > m_slots.size())
+        {
+            rehash(names * 2);
+        }
+    }
+
+    /**
+     * @brief Inserts the name or replaces the index of an existing entry.
+     *
+     */
+    void insert(std::string_view name, size_t index)
+    {
+        reserve(m_size + 1);
+        auto hash = fnv1a(name);
+        auto& slot = m_slots[probe(name, hash)];
+        if (slot.index == npos)
+        {
+            ++m_size;
+            slot.name = name;
+            slot.hash = hash;
+        }
+        slot.index = index;
+    }
+
+    [[nodiscard]] size_t find(std::string_view name) const
+    {
+        return m_slots.empty() ? npos
+                               : m_slots[probe(name, fnv1a(name))].index;
+    }
+
+    [[nodiscard]] size_t size() const { return m_size; }
+
+private:
+    struct Slot
+    {
+        std::string_view name;
+        // compared first so names are only touched for likely matches
+        uint64_t hash = 0;
+        size_t index = npos;
+    };
+
+    std::vector<Slot> m_slots;
+    size_t m_size = 0;
+
+    // index of the slot holding name or of the empty slot it belongs into
+    [[nodiscard]] size_t probe(std::string_view name, uint64_t hash) const
+    {
+        size_t mask = m_slots.size() - 1;
+        size_t pos = hash & mask;
+        while (m_slots[pos].index != npos &&
+               (m_slots[pos].hash != hash || m_slots[pos].name != name))
+        {
+            pos = (pos + 1) & mask;
+        }
+        return pos;
+    }
+
+    void rehash(size_t capacity)
+    {
+        size_t slots = 16;
+        while (slots < capacity)
+        {
+            slots *= 2;
+        }
+
+        auto old_slots = std::move(m_slots);
+        m_slots.assign(slots, Slot{});
+        for (const auto& slot : old_slots)
+        {
+            if (slot.index != npos)
+            {
+                m_slots[probe(slot.name, slot.hash)] = slot;
+            }
+        }
+    }
+};
+
+#ifdef CLAPP_ENABLE_THREADS
+
+/**
+ * @brief Runs a set of tasks on worker threads. A task becomes ready once all
+ * tasks it depends on have completed. Tasks depending on a failed or skipped
+ * task are skipped. The destructor waits for the workers.
+ *
+ */
+class TaskGraph
+{
+public:
+    /**
+     * @param dependents Tasks waiting for each task.
+     * @param pending Number of tasks each task waits for.
+     */
+    TaskGraph(std::function<void(size_t)> run,
+              std::vector<std::vector<size_t>> dependents,
+              std::vector<size_t> pending, size_t threads)
+        : m_run{std::move(run)}, m_dependents{std::move(dependents)},
+          m_pending{std::move(pending)}, m_skipped(m_pending.size(), false),
+          m_errors(m_pending.size()), m_remaining{m_pending.size()}
+    {
+        for (size_t task = 0; task < m_pending.size(); ++task)
+        {
+            if (m_pending[task] == 0)
+            {
+                m_ready.push_back(task);
+            }
+        }
+
+        threads = std::max<size_t>(1, std::min(threads, m_pending.size()));
+        m_workers.reserve(threads);
+        for (size_t i = 0; i < threads; ++i)
+        {
+            m_workers.emplace_back([this] { work(); });
+        }
+    }
+
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    ~TaskGraph() { join(); }
+
+    void join()
+    {
+        for (auto& worker : m_workers)
+        {
+            if (worker.joinable())
+            {
+                worker.join();
+            }
+        }
+    }
+
+    [[nodiscard]] size_t size() const { return m_errors.size(); }
+
+    /**
+     * @brief Exception thrown by the task. Only valid after join().
+     *
+     */
+    [[nodiscard]] std::exception_ptr error(size_t task) const
+    {
+        return m_errors[task];
+    }
+
+private:
+    void work()
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        while (true)
+        {
+            m_changed.wait(
+                lock, [this] { return !m_ready.empty() || m_remaining == 0; });
+            if (m_ready.empty())
+            {
+                return;
+            }
+
+            auto task = m_ready.front();
+            m_ready.pop_front();
+            bool failed = m_skipped[task];
+            if (!failed)
+            {
+                lock.unlock();
+                try
+                {
+                    m_run(task);
+                }
+                catch (...)
+                {
+                    m_errors[task] = std::current_exception();
+                    failed = true;
+                }
+                lock.lock();
+            }
+
+            for (auto dependent : m_dependents[task])
+            {
+                m_skipped[dependent] = m_skipped[dependent] || failed;
+                if (--m_pending[dependent] == 0)
+                {
+                    m_ready.push_back(dependent);
+                }
+            }
+            --m_remaining;
+            m_changed.notify_all();
+        }
+    }
+
+    std::function<void(size_t)> m_run;
+    std::vector<std::vector<size_t>> m_dependents;
+    std::vector<size_t> m_pending;
+    std::vector<bool> m_skipped;
+    std::vector<std::exception_ptr> m_errors;
+    size_t m_remaining;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::deque<size_t> m_ready;
+    std::vector<std::thread> m_workers;
+};
+
+/**
+ * @brief Warms the page cache for files that are read after parsing. Files
+ * are read completely by a helper thread that is started on first use.
+ * Errors are ignored, prefetching never changes the result of parsing.
+ *
+ */
+class Prefetcher
+{
+public:
+    Prefetcher() = default;
+    Prefetcher(const Prefetcher&) = delete;
+    Prefetcher& operator=(const Prefetcher&) = delete;
+
+    ~Prefetcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_stop = true;
+        }
+        m_changed.notify_all();
+        if (m_worker.joinable())
+        {
+            m_worker.join();
+        }
+    }
+
+    /**
+     * @brief Queues the file to be read completely by the helper thread.
+     *
+     */
+    void read(std::string path)
+    {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_queue.push_back(std::move(path));
+            ++m_pending;
+        }
+        if (!m_worker.joinable())
+        {
+            m_worker = std::thread([this] { work(); });
+        }
+        m_changed.notify_all();
+    }
+
+    /**
+     * @brief Waits until all queued files have been read.
+     *
+     */
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_changed.wait(lock, [this] { return m_pending == 0; });
+    }
+
+private:
+    void work()
+    {
+        std::vector<char> buffer(1 << 16);
+        std::unique_lock<std::mutex> lock{m_mutex};
+        while (true)
+        {
+            m_changed.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+            if (m_stop)
+            {
+                return;
+            }
+
+            auto path = std::move(m_queue.front());
+            m_queue.pop_front();
+            lock.unlock();
+
+            std::ifstream file(path, std::ios::binary);
+            while (file.read(buffer.data(), buffer.size()) && !m_stop)
+            {
+            }
+
+            lock.lock();
+            --m_pending;
+            m_changed.notify_all();
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::deque<std::string> m_queue;
+    size_t m_pending = 0;
+    std::atomic<bool> m_stop{false};
+    std::thread m_worker;
+};
+
+#endif
+
+/**
+ * @brief Asks the kernel to read the file ahead asynchronously. Errors are
+ * ignored.
+ *
+ */
+inline void adviseReadahead(const std::string& path)
+{
+#if defined(CLAPP_HAS_MMAP) && defined(POSIX_FADV_WILLNEED)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        ::close(fd);
+    }
+#else
+    (void)path;
+#endif
+}
+
+/**
+ * @brief Persistent set of keys of command lines that passed validation. The
+ * file holds the most recent keys and is replaced atomically when a key is
+ * added. A missing or malformed file is treated as empty.
+ *
+ */
+class VerdictCache
+{
+public:
+    static constexpr size_t MaxKeys = 1024;
+
+    explicit VerdictCache(std::string path) : m_path{std::move(path)} {}
+
+    [[nodiscard]] const std::string& path() const { return m_path; }
+
+    bool contains(uint64_t key)
+    {
+        load();
+        return std::find(m_keys.begin(), m_keys.end(), key) != m_keys.end();
+    }
+
+    /**
+     * @brief Adds the key and writes the file. Errors are ignored, the cache
+     * only ever saves work.
+     *
+     */
+    void insert(uint64_t key)
+    {
+        load();
+        if (std::find(m_keys.begin(), m_keys.end(), key) != m_keys.end())
+        {
+            return;
+        }
+        if (m_keys.size() == MaxKeys)
+        {
+            m_keys.erase(m_keys.begin());
+        }
+        m_keys.push_back(key);
+
+        std::string out(Magic, sizeof(Magic));
+        for (auto cached : m_keys)
+        {
+            out.append(reinterpret_cast<const char*>(&cached), sizeof(cached));
+        }
+
+        // every writer uses its own temporary file, concurrent processes
+        // never write into the same file
+#ifdef CLAPP_HAS_MMAP
+        auto temporary = m_path + ".XXXXXX";
+        int fd = ::mkstemp(temporary.data());
+        if (fd < 0)
+        {
+            return;
+        }
+        bool written = writeAll(fd, out);
+        written = ::close(fd) == 0 && written;
+#else
+        static std::atomic<unsigned> counter{0};
+        auto temporary =
+            m_path + "." +
+            std::to_string(reinterpret_cast<std::uintptr_t>(this)) + "." +
+            std::to_string(counter++) + ".tmp";
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(out.data(), static_cast<std::streamsize>(out.size()));
+        file.close();
+        bool written = static_cast<bool>(file);
+#endif
+        if (!written || std::rename(temporary.c_str(), m_path.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+        }
+    }
+
+private:
+    static constexpr char Magic[4] = {'C', 'L', 'P', 'V'};
+
+    std::string m_path;
+    std::vector<uint64_t> m_keys;
+    bool m_loaded = false;
+
+    void load()
+    {
+        if (m_loaded)
+        {
+            return;
+        }
+        m_loaded = true;
+
+        FileMapping mapping;
+        if (!mapping.open(m_path))
+        {
+            return;
+        }
+        auto content = mapping.view();
+        if (content.size() < sizeof(Magic) ||
+            content.compare(0, sizeof(Magic), Magic, sizeof(Magic)) != 0 ||
+            (content.size() - sizeof(Magic)) % sizeof(uint64_t) != 0)
+        {
+            return;
+        }
+
+        content.remove_prefix(sizeof(Magic));
+        m_keys.resize(std::min(content.size() / sizeof(uint64_t), MaxKeys));
+        std::memcpy(m_keys.data(), content.data(),
+                    m_keys.size() * sizeof(uint64_t));
+    }
+
+#ifdef CLAPP_HAS_MMAP
+    static bool writeAll(int fd, std::string_view data)
+    {
+        while (!data.empty())
+        {
+            auto written = ::write(fd, data.data(), data.size());
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (written <= 0)
+            {
+                return false;
+            }
+            data.remove_prefix(static_cast<size_t>(written));
+        }
+        return true;
+    }
+#endif
+};
+
+/**
+ * @brief Append-only storage for strings that live as long as the parser.
+ * Strings are copied into blocks that grow geometrically, so interning many
+ * names costs few allocations. Views returned by intern() are NUL terminated
+ * and stay valid until the arena is destroyed.
+ *
+ */
+class StringArena
+{
+public:
+    static constexpr size_t BlockSize = 4096;
+
+    StringArena() = default;
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+
+    ~StringArena()
+    {
+        while (m_blocks != nullptr)
+        {
+            auto* block = m_blocks;
+            m_blocks = block->next;
+            ::operator delete(block);
+        }
+    }
+
+    /**
+     * @brief Makes sure the next bytes of strings fit into one block.
+     *
+     */
+    void reserve(size_t bytes)
+    {
+        if (bytes > m_free)
+        {
+            allocate(bytes);
+        }
+    }
+
+    std::string_view intern(std::string_view text)
+    {
+        if (text.empty())
+        {
+            return {};
+        }
+
+        auto size = text.size() + 1;
+        reserve(size);
+        char* target = m_next;
+        m_next += size;
+        m_free -= size;
+
+        std::memcpy(target, text.data(), text.size());
+        target[text.size()] = '\0';
+        return {target, text.size()};
+    }
+
+private:
+    struct Block
+    {
+        Block* next;
+    };
+
+    Block* m_blocks = nullptr;
+    char* m_next = nullptr;
+    size_t m_free = 0;
+    size_t m_capacity = 0;
+
+    void allocate(size_t bytes)
+    {
+        auto capacity = std::max({bytes, BlockSize, m_capacity});
+        auto* block =
+            static_cast<Block*>(::operator new(sizeof(Block) + capacity));
+        block->next = m_blocks;
+        m_blocks = block;
+        m_next = reinterpret_cast<char*>(block + 1);
+        m_free = capacity;
+        m_capacity += capacity;
+    }
+};
+
+inline std::string_view trim(std::string_view str)
+{
+    const char* whitespace = " \t\r\n";
+    auto begin = str.find_first_not_of(whitespace);
+    if (begin == std::string_view::npos)
+    {
+        return {};
+    }
+    auto end = str.find_last_not_of(whitespace);
+    return str.substr(begin, end - begin + 1);
+}
+
+/**
+ * @brief Allowed values listed one per line in a memory-mapped file. Empty
+ * lines and lines starting with '#' are ignored. The sorted index of views
+ * into the mapping is built on the first lookup.
+ *
+ */
+class ChoiceFile
+{
+public:
+    bool open(const std::string& path)
+    {
+        m_values.clear();
+        m_indexed = false;
+        return m_mapping.open(path);
+    }
+
+    [[nodiscard]] bool contains(std::string_view value)
+    {
+        index();
+        return std::binary_search(m_values.begin(), m_values.end(), value);
+    }
+
+    [[nodiscard]] size_t size()
+    {
+        index();
+        return m_values.size();
+    }
+
+private:
+    FileMapping m_mapping;
+    std::vector<std::string_view> m_values;
+    bool m_indexed = false;
+
+    void index()
+    {
+        if (m_indexed)
+        {
+            return;
+        }
+        m_indexed = true;
+
+        auto content = m_mapping.view();
+        m_values.reserve(static_cast<size_t>(
+            std::count(content.begin(), content.end(), '\n') + 1));
+        while (!content.empty())
+        {
+            auto line_end = content.find('\n');
+            auto line = trim(content.substr(0, line_end));
+            content.remove_prefix(line_end == std::string_view::npos
+                                      ? content.size()
+                                      : line_end + 1);
+            if (!line.empty() && line.front() != '#')
+            {
+                m_values.push_back(line);
+            }
+        }
+        std::sort(m_values.begin(), m_values.end());
+        m_values.erase(std::unique(m_values.begin(), m_values.end()),
+                       m_values.end());
+        m_values.shrink_to_fit();
+    }
+};
+
+} // namespace detail
+
+/* Command line splitting */
+
+/**
+ * @brief Splits a single command line string into arguments like a POSIX
+ * shell: whitespace separates arguments, single quotes preserve everything
+ * literally, double quotes allow escaping of $, `, " and \, and a backslash
+ * outside of quotes escapes the next character. Arguments are views into the
+ * command line unless they contain quotes or escapes, in which case they are
+ * unescaped into a buffer that is reused for every argument.
+ *
+ */
+class CommandLineSplitter
+{
+public:
+    explicit CommandLineSplitter(std::string_view command_line)
+        : m_rest{command_line}
+    {
+    }
+
+    /**
+     * @brief Extracts the next argument. The view is valid until the next
+     * call. Returns false at the end of the command line or if a quote is
+     * not terminated, see unterminated().
+     *
+     * @param argument Receives the argument.
+     * @return bool
+     */
+    bool next(std::string_view& argument)
+    {
+        auto begin = m_rest.find_first_not_of(" \t\r\n");
+        if (begin == std::string_view::npos)
+        {
+            m_rest = {};
+            return false;
+        }
+        m_rest.remove_prefix(begin);
+
+        // fast path for arguments without quotes and escapes
+        auto end = m_rest.find_first_of(" \t\r\n'\"\\");
+        if (end == std::string_view::npos ||
+            std::strchr(" \t\r\n", m_rest[end]) != nullptr)
+        {
+            argument = m_rest.substr(0, end);
+            m_rest.remove_prefix(argument.size());
+            return true;
+        }
+
+        m_buffer.assign(m_rest.data(), end);
+        char quote = 0;
+        size_t pos = end;
+        for (; pos < m_rest.size(); ++pos)
+        {
+            char c = m_rest[pos];
+            if (quote == '\'')
+            {
+                if (c == '\'')
+                {
+                    quote = 0;
+                }
+                else
+                {
+                    m_buffer.push_back(c);
+                }
+            }
+            else if (c == '\\' && pos + 1 < m_rest.size() &&
+                     (quote == 0 ||
+                      std::strchr("$`\"\\\n", m_rest[pos + 1]) != nullptr))
+            {
+                ++pos;
+                if (m_rest[pos] != '\n')
+                {
+                    m_buffer.push_back(m_rest[pos]);
+                }
+            }
+            else if (c == '"')
+            {
+                quote = quote == 0 ? '"' : 0;
+            }
+            else if (c == '\'' && quote == 0)
+            {
+                quote = '\'';
+            }
+            else if (quote == 0 && std::strchr(" \t\r\n", c) != nullptr)
+            {
+                break;
+            }
+            else
+            {
+                m_buffer.push_back(c);
+            }
+        }
+
+        m_rest.remove_prefix(pos);
+        if (quote != 0)
+        {
+            m_unterminated = true;
+            m_rest = {};
+            return false;
+        }
+
+        argument = m_buffer;
+        return true;
+    }
+
+    /**
+     * @brief True if the command line ended inside of a quoted string.
+     *
+     */
+    [[nodiscard]] bool unterminated() const { return m_unterminated; }
+
+private:
+    std::string_view m_rest;
+    std::string m_buffer;
+    bool m_unterminated = false;
+};
+
+/* Memory-mapped files */
+
+/**
+ * @brief Option value type for input files. Converting an argument opens the
+ * file and maps it read-only, so the contents are available without copying
+ * or reading them. Move-only, the mapping is released by the destructor.
+ *
+ */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+
+    /**
+     * @brief Maps the file at the given path. Returns false if the file
+     * cannot be opened or mapped, errno describes the error.
+     *
+     */
+    bool open(std::string path)
+    {
+        errno = 0;
+        if (!m_mapping.open(path))
+        {
+            m_path.clear();
+            return false;
+        }
+        m_path = std::move(path);
+        return true;
+    }
+
+    [[nodiscard]] const std::string& path() const { return m_path; }
+    [[nodiscard]] std::string_view view() const { return m_mapping.view(); }
+    [[nodiscard]] const char* data() const { return view().data(); }
+    [[nodiscard]] size_t size() const { return view().size(); }
+    [[nodiscard]] bool empty() const { return view().empty(); }
+    [[nodiscard]] const char* begin() const { return data(); }
+    [[nodiscard]] const char* end() const { return data() + size(); }
+
+    operator std::string_view() const { return view(); }
+
+private:
+    std::string m_path;
+    detail::FileMapping m_mapping;
+};
+
+inline std::errc parseValue(std::string_view text, MappedFile& value)
+{
+    if (!value.open(std::string{text}))
+    {
+        return errno != 0 ? static_cast<std::errc>(errno)
+                          : std::errc::invalid_argument;
+    }
+    return {};
+}
+
+/**
+ * @brief Marks a string that outlives the parser, e.g. a string literal or an
+ * entry of a static table, so that it is referenced instead of copied.
+ *
+ */
+struct StaticText
+{
+    constexpr explicit StaticText(std::string_view text) : value{text} {}
+
+    std::string_view value;
+};
+
+namespace literals
+{
+/**
+ * @brief String literal that is referenced by the parser instead of copied,
+ * e.g. parser.option("--name"_static).
+ *
+ */
+constexpr StaticText operator""_static(const char* text, size_t size)
+{
+    return StaticText{std::string_view(text, size)};
+}
+} // namespace literals
+
+/**
+ * @brief Name or text of an option. StaticText is referenced and must outlive
+ * the parser, all other strings, string literals included, are copied into
+ * the string arena of the parser.
+ *
+ */
+struct OptionName
+{
+    OptionName() = default;
+    OptionName(const char* name) : value{name} {}
+    OptionName(std::string_view name) : value{name} {}
+    OptionName(const std::string& name) : value{name} {}
+    OptionName(StaticText text) : value{text.value}, is_static{true} {}
+
+    std::string_view value;
+    bool is_static = false;
+};
+
+/**
+ * @brief How the file named by an option value is prefetched while the
+ * remaining arguments are parsed. Advise asks the kernel to read the file
+ * ahead, Read reads it completely on a helper thread of the parser. Read
+ * requires CLAPP_ENABLE_THREADS and behaves like Advise otherwise.
+ *
+ */
+enum class Prefetch
+{
+    None,
+    Advise,
+    Read
+};
+
+/* Errors */
+
+/**
+ * @brief Kind of a command line error.
+ *
+ */
+enum class ErrorKind
+{
+    None,
+    UnknownOption,
+    MissingValue,
+    InvalidValue,
+    ValueNotAllowed,
+    ValidationFailed,
+    RequiredOption,
+    CapacityExceeded
+};
+
+/**
+ * @brief Static description of an error kind.
+ *
+ */
+inline const char* errorMessage(ErrorKind kind)
+{
+    switch (kind)
+    {
+    case ErrorKind::None:
+        return "No error";
+    case ErrorKind::UnknownOption:
+        return "Unknown option";
+    case ErrorKind::MissingValue:
+        return "Expected argument, but none given";
+    case ErrorKind::InvalidValue:
+        return "Invalid value";
+    case ErrorKind::ValueNotAllowed:
+        return "Value not allowed";
+    case ErrorKind::ValidationFailed:
+        return "Value failed validation";
+    case ErrorKind::RequiredOption:
+        return "Option is required";
+    case ErrorKind::CapacityExceeded:
+        return "Too many options";
+    }
+    return "Unknown error";
+}
+
+/* Argument parser */
+
+class ArgumentParser
+{
+public:
+    struct Option;
+
+    /**
+     * @brief Exception used for errors during the command line parsing. For
+     * example if an option is missing but required. Parse errors are
+     * recorded as kind, option, argument and offending value, the message is
+     * only formatted when what() or format() is called.
+     *
+     */
+    class ArgumentParserException : public std::runtime_error
+    {
+    public:
+        static constexpr size_t NoIndex = static_cast<size_t>(-1);
+
+        explicit ArgumentParserException(const std::string& what)
+            : std::runtime_error(what)
+        {
+        }
+
+        /**
+         * @brief Records an error without formatting a message. The names,
+         * value and detail are copied into one allocation shared by all
+         * copies of the exception, it does not refer to the parser.
+         *
+         */
+        ArgumentParserException(ErrorKind kind, const Option* option,
+                                std::string_view value = {},
+                                std::string_view detail = {},
+                                std::errc code = {})
+            : std::runtime_error(""), m_kind{kind}, m_code{code}
+        {
+            std::string_view parts[Parts] = {{}, {}, value, detail};
+            if (option != nullptr)
+            {
+                parts[ShortName] = option->short_option;
+                parts[LongName] = option->long_option;
+            }
+
+            size_t size = 0;
+            for (auto text : parts)
+            {
+                size += text.size();
+            }
+
+            // one allocation for the record and the parts behind it
+            auto* record = new (::operator new(sizeof(Record) + size)) Record;
+            char* text = const_cast<char*>(record->text());
+            size_t end = 0;
+            for (size_t idx = 0; idx < Parts; ++idx)
+            {
+                std::copy(parts[idx].begin(), parts[idx].end(), text + end);
+                end += parts[idx].size();
+                record->ends[idx] = end;
+            }
+            m_record = SharedRecord(record);
+        }
+
+        [[nodiscard]] ErrorKind kind() const { return m_kind; }
+
+        /**
+         * @brief Index of the option in registration order or NoIndex.
+         *
+         */
+        [[nodiscard]] size_t option() const { return m_option; }
+
+        /**
+         * @brief Index of the offending command line argument, not counting
+         * the program name, or NoIndex.
+         *
+         */
+        [[nodiscard]] size_t argument() const { return m_argument; }
+
+        /**
+         * @brief Offending value.
+         *
+         */
+        [[nodiscard]] std::string_view value() const { return part(Value); }
+
+        /**
+         * @brief Appends the error message to out.
+         *
+         */
+        void format(std::string& out) const
+        {
+            switch (m_kind)
+            {
+            case ErrorKind::None:
+                out.append(std::runtime_error::what());
+                break;
+            case ErrorKind::UnknownOption:
+                out.append("Unknown option '");
+                appendPart(out, Value);
+                out.append("'.");
+                break;
+            case ErrorKind::MissingValue:
+                out.append("Expected argument after '");
+                appendName(out);
+                out.append("', but none given.");
+                break;
+            case ErrorKind::InvalidValue:
+                out.append("Invalid value '");
+                appendPart(out, Value);
+                out.append("' for option '");
+                appendName(out);
+                out.append("': ")
+                    .append(std::make_error_code(m_code).message())
+                    .append(".");
+                break;
+            case ErrorKind::ValueNotAllowed:
+                out.append("Value '");
+                appendPart(out, Value);
+                out.append("' not allowed.");
+                break;
+            case ErrorKind::ValidationFailed:
+                out.append("Value '");
+                appendPart(out, Value);
+                out.append("' for option '");
+                appendName(out);
+                out.append("' ");
+                appendPart(out, Detail);
+                out.append(".");
+                break;
+            case ErrorKind::RequiredOption:
+                out.append("Option '");
+                appendName(out);
+                out.append("' is required.");
+                break;
+            default:
+                out.append(errorMessage(m_kind)).append(".");
+                break;
+            }
+        }
+
+        [[nodiscard]] const char* what() const noexcept override
+        {
+            if (m_kind == ErrorKind::None)
+            {
+                return std::runtime_error::what();
+            }
+
+            // formatted once, copies rethrown on other threads may race to
+            // install the message and the losers use the installed one
+            const std::string* message =
+                m_record->message.load(std::memory_order_acquire);
+            if (message == nullptr)
+            {
+                try
+                {
+                    auto formatted = std::make_unique<std::string>();
+                    format(*formatted);
+                    if (m_record->message.compare_exchange_strong(
+                            message, formatted.get(),
+                            std::memory_order_acq_rel,
+                            std::memory_order_acquire))
+                    {
+                        message = formatted.release();
+                    }
+                }
+                catch (...)
+                {
+                    return errorMessage(m_kind);
+                }
+            }
+            return message->c_str();
+        }
+
+    private:
+        friend class ArgumentParser;
+
+        enum Part
+        {
+            ShortName,
+            LongName,
+            Value,
+            Detail,
+            Parts
+        };
+
+        /**
+         * @brief Error record shared by the copies of an exception. The parts
+         * are stored one after another behind the record, ends[part] is the
+         * end of each.
+         *
+         */
+        struct Record
+        {
+            Record() = default;
+            Record(const Record&) = delete;
+            Record& operator=(const Record&) = delete;
+            ~Record() { delete message.load(); }
+
+            [[nodiscard]] const char* text() const
+            {
+                return reinterpret_cast<const char*>(this + 1);
+            }
+
+            std::atomic<size_t> references{1};
+            size_t ends[Parts] = {};
+            mutable std::atomic<const std::string*> message{nullptr};
+        };
+
+        /**
+         * @brief Reference counted pointer to a Record, copies never throw.
+         *
+         */
+        class SharedRecord
+        {
+        public:
+            SharedRecord() = default;
+            explicit SharedRecord(Record* record) : m_record{record} {}
+
+            SharedRecord(const SharedRecord& other) noexcept
+                : m_record{other.m_record}
+            {
+                if (m_record != nullptr)
+                {
+                    m_record->references.fetch_add(1,
+                                                   std::memory_order_relaxed);
+                }
+            }
+
+            SharedRecord& operator=(const SharedRecord& other) noexcept
+            {
+                SharedRecord copy(other);
+                std::swap(m_record, copy.m_record);
+                return *this;
+            }
+
+            ~SharedRecord()
+            {
+                if (m_record != nullptr &&
+                    m_record->references.fetch_sub(
+                        1, std::memory_order_acq_rel) == 1)
+                {
+                    m_record->~Record();
+                    ::operator delete(m_record);
+                }
+            }
+
+            explicit operator bool() const { return m_record != nullptr; }
+            const Record* operator->() const { return m_record; }
+
+        private:
+            Record* m_record = nullptr;
+        };
+
+        ErrorKind m_kind = ErrorKind::None;
+        std::errc m_code{};
+        size_t m_option = NoIndex;
+        size_t m_argument = NoIndex;
+        SharedRecord m_record;
+
+        ArgumentParserException& at(size_t option, size_t argument)
+        {
+            m_option = option;
+            m_argument = argument;
+            return *this;
+        }
+
+        [[nodiscard]] std::string_view part(Part part) const
+        {
+            if (!m_record)
+            {
+                return {};
+            }
+            size_t begin = part == 0 ? 0 : m_record->ends[part - 1];
+            return {m_record->text() + begin, m_record->ends[part] - begin};
+        }
+
+        void appendPart(std::string& out, Part part) const
+        {
+            out.append(this->part(part));
+        }
+
+        void appendName(std::string& out) const
+        {
+            appendPart(out, ShortName);
+            if (!part(LongName).empty())
+            {
+                out.append(" (");
+                appendPart(out, LongName);
+                out.append(")");
+            }
+        }
+    };
+
+    /**
+     * @brief Option class representing a command line option the user can
+     * specify. Use for internal purposes only.
+     *
+     */
+    struct Option
+    {
+        virtual ~Option() = default;
+        friend class ArgumentParser;
+
+    protected:
+        Option(std::string_view _short_option, std::string_view _long_option)
+            : short_option{_short_option}, long_option{_long_option}
+        {
+        }
+
+        virtual void setValue(std::string_view value, bool validate) = 0;
+        [[nodiscard]] virtual bool isPositionalOption() const = 0;
+        virtual std::set<std::string> choices() = 0;
+        virtual void invokeCallback() = 0;
+        [[nodiscard]] virtual const char* typeName() const = 0;
+        virtual bool encodeValue(std::string& out) const = 0;
+        virtual bool decodeValue(std::string_view& in, bool apply) = 0;
+        virtual void applyLazyDefault() = 0;
+        virtual void resetValue() = 0;
+        [[nodiscard]] virtual uint64_t hashValidators(uint64_t hash) const = 0;
+
+        bool operator<(const Option& other) { return name() < other.name(); }
+
+        [[nodiscard]] std::string name() const
+        {
+            std::stringstream ss;
+            ss << short_option;
+            if (!long_option.empty())
+            {
+                ss << " (" << long_option << ")";
+            }
+            return ss.str();
+        }
+
+        // views of StaticText or of the string arena of the parser, views
+        // of the arena are NUL terminated
+        std::string_view argument_name;
+        std::string_view short_option;
+        std::string_view long_option;
+        std::string_view description;
+        std::string_view env_variable;
+        std::string_view default_placeholder;
+        std::string_view choices_file;
+
+        bool required = false;
+        bool flag = false;
+        bool overruling = false;
+        bool has_default_value = false;
+        bool has_lazy_default = false;
+        Prefetch prefetch = Prefetch::None;
+    };
+
+    /**
+     * @brief Wrapper of an user specified option that can be interacted with.
+     * To configure the option use the public member functions of this class.
+     *
+     * @tparam T
+     */
+    template <typename T> class OptionWrapper : public Option
+    {
+    public:
+        OptionWrapper(detail::ValueStorage& storage,
+                      detail::StringArena& strings, std::string_view short_name,
+                      std::string_view long_name)
+            : Option(short_name, long_name), m_strings{&strings}
+        {
+            std::tie(m_storage, m_slot) = storage.add<T>();
+        }
+
+        OptionWrapper(const OptionWrapper&) = delete;
+        ~OptionWrapper() override = default;
+
+        /**
+         * @brief Argument name.
+         *
+         * @param name Argument name displayed in the help message.
+         * @return OptionWrapper<T>&
+         */
+        OptionWrapper<T>& argument(OptionName name)
+        {
+            Option::argument_name = intern(name);
+            return *this;
+        }
+
+        /**
+         * @brief Describes what the option does. Displayed in the help message.
+         *
+         * @param description Description of the option.
+         */
+        OptionWrapper<T>& description(OptionName description)
+        {
+            Option::description = intern(description);
+            return *this;
+        }
+
+        /**
+         * @brief Option must not be specified.
+         *
+         */
+        OptionWrapper<T>& optional()
+        {
+            Option::required = false;
+            return *this;
+        }
+
+        /**
+         * @brief Option must be specified.
+         *
+         */
+        OptionWrapper<T>& required()
+        {
+            Option::required = true;
+            return *this;
+        }
+
+        /**
+         * @brief Where the value is stored. The variable becomes the storage
+         * of the option: the current value (e.g. the default value) is moved
+         * into it, parsed values are assigned to it directly and value()
+         * refers to it. It must outlive the option.
+         *
+         * @param store Storage
+         */
+        OptionWrapper<T>& store(T& store)
+        {
+            if (&store != m_ref)
+            {
+                store = std::move(value());
+                m_ref = &store;
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Function to be called if a value has been stored.
+         *
+         * @param callback Callback function
+         */
+        OptionWrapper<T>& callback(std::function<void(const T&)> callback)
+        {
+            m_callback = std::move(callback);
+            return *this;
+        }
+
+        /**
+         * @brief Environment variable the value is read from if the option is
+         * not given on the command line. Takes precedence over config files.
+         *
+         * @param variable Name of the environment variable.
+         */
+        OptionWrapper<T>& env(const std::string& variable)
+        {
+            Option::env_variable = m_strings->intern(variable);
+            return *this;
+        }
+
+        /**
+         * @brief Option has no arguments and is treated as a flag.
+         *
+         */
+        OptionWrapper<T>& flag()
+        {
+            Option::flag = true;
+            return *this;
+        }
+
+        /**
+         * @brief Default value if the option is not specified.
+         *
+         * @param value Some default value.
+         * @return OptionWrapper<T>&
+         */
+        OptionWrapper<T>& defaultValue(T value)
+        {
+            Option::has_default_value = true;
+            Option::has_lazy_default = false;
+            defaults().generator = nullptr;
+            keepDefault(value);
+            assign(std::move(value));
+            return *this;
+        }
+
+        /**
+         * @brief Default value computed by a generator. The generator only
+         * runs if the option is not specified after parsing and at most once,
+         * the result is kept like a regular default value.
+         *
+         * @param generator Function returning the default value.
+         * @param placeholder Displayed in the help message instead of the
+         * value, e.g. "number of CPUs".
+         * @return OptionWrapper<T>&
+         */
+        // callables are generators even if they convert to T, as captureless
+        // lambdas do to bool through their function pointer
+        template <typename Generator,
+                  typename = std::enable_if_t<
+                      std::is_invocable_r_v<T, Generator&>>>
+        OptionWrapper<T>& defaultValue(Generator generator,
+                                       std::string placeholder = {})
+        {
+            Option::has_default_value = true;
+            Option::has_lazy_default = true;
+            Option::default_placeholder = m_strings->intern(placeholder);
+            defaults().generator = std::move(generator);
+            defaults().value.reset();
+            return *this;
+        }
+
+        /**
+         * @brief This arguments stops the parsing and executes a specified
+         * callback.
+         *
+         * @return OptionWrapper<T>&
+         */
+        OptionWrapper<T>& overruling()
+        {
+            Option::overruling = true;
+            return *this;
+        }
+
+        /**
+         * @brief The value is the path of a file that is read after parsing.
+         * The file is prefetched into the page cache as soon as the value is
+         * accepted. Errors while prefetching are ignored.
+         *
+         * @param policy How the file is prefetched.
+         * @return OptionWrapper<T>&
+         */
+        OptionWrapper<T>& prefetch(Prefetch policy = Prefetch::Advise)
+        {
+            Option::prefetch = policy;
+            return *this;
+        }
+
+        /**
+         * @brief Provide values that are allowed to be specified.
+         *
+         * @param values
+         * @return OptionWrapper<T>&
+         */
+        OptionWrapper<T>& choices(std::initializer_list<T> values)
+        {
+            validators().choices = values;
+            return *this;
+        }
+
+        /**
+         * @brief Provide values that are allowed to be specified.
+         *
+         * @param values
+         * @return OptionWrapper<T>&
+         */
+        OptionWrapper<T>& choices(const std::set<T>& values)
+        {
+            validators().choices = values;
+            return *this;
+        }
+
+        /**
+         * @brief Allowed values are listed one per line in the given file,
+         * for sets too large to build in code. The file is memory-mapped and
+         * indexed on the first validation, the help message refers to the
+         * file instead of listing the values. Values are compared as given
+         * on the command line.
+         *
+         * @param path Path of the file.
+         * @return OptionWrapper<T>&
+         */
+        OptionWrapper<T>& choicesFromFile(const std::string& path)
+        {
+            auto choice_file = std::make_unique<detail::ChoiceFile>();
+            if (!choice_file->open(path))
+            {
+                throw ArgumentParserException("Cannot read choices file '" +
+                                              path + "'.");
+            }
+            validators().choice_file = std::move(choice_file);
+            Option::choices_file = m_strings->intern(path);
+            return *this;
+        }
+
+        /**
+         * @brief Values must lie within [min, max].
+         *
+         * @param min Smallest allowed value.
+         * @param max Largest allowed value.
+         * @return OptionWrapper<T>&
+         */
+        OptionWrapper<T>& range(T min, T max)
+        {
+            static_assert(detail::IsLessComparable<T>::value,
+                          "range() requires a type with operator<.");
+            if (max < min)
+            {
+                throw ArgumentParserException(
+                    "Invalid range for option '" + name() + "'.");
+            }
+            validators().range.emplace(std::move(min), std::move(max));
+            return *this;
+        }
+
+        /**
+         * @brief Values must lie within [Min, Max]. The bounds are checked at
+         * compile time.
+         *
+         * @tparam Min Smallest allowed value.
+         * @tparam Max Largest allowed value.
+         * @return OptionWrapper<T>&
+         */
+        template <auto Min, auto Max> OptionWrapper<T>& range()
+        {
+            static_assert(!(Max < Min), "Invalid range.");
+            return range(T(Min), T(Max));
+        }
+
+#ifdef CLAPP_ENABLE_REGEX
+        /**
+         * @brief Values must match the regular expression. The expression is
+         * compiled once. Requires CLAPP_ENABLE_REGEX.
+         *
+         * @param regex ECMAScript regular expression.
+         * @return OptionWrapper<T>&
+         */
+        OptionWrapper<T>& pattern(const std::string& regex)
+        {
+            static_assert(std::is_same_v<T, std::string> ||
+                              std::is_same_v<T, std::string_view>,
+                          "pattern() requires a string value.");
+            auto compiled =
+                std::make_shared<const std::regex>(regex, std::regex::optimize);
+            return validate(
+                [compiled](const T& value)
+                {
+                    return std::regex_match(value.begin(), value.end(),
+                                            *compiled);
+                },
+                "does not match the pattern");
+        }
+#endif
+
+        /**
+         * @brief Values must satisfy the predicate.
+         *
+         * @param predicate Returns false for invalid values.
+         * @param message Describes the requirement in error messages.
+         * @return OptionWrapper<T>&
+         */
+        OptionWrapper<T>& validate(std::function<bool(const T&)> predicate,
+                                   std::string message = "is not valid")
+        {
+            validators().predicates.emplace_back(std::move(predicate),
+                                                 std::move(message));
+            return *this;
+        }
+
+        /**
+         * @brief Current value stored in the option. The reference stays
+         * valid while the parser exists.
+         *
+         * @return T&
+         */
+        T& value() { return m_ref != nullptr ? *m_ref : (*m_storage)[m_slot]; }
+
+    private:
+        friend class ArgumentParser;
+        /**
+         * @brief Allowed values and validators, only allocated if the option
+         * has any.
+         *
+         */
+        struct Validators
+        {
+            std::set<T> choices;
+            std::unique_ptr<detail::ChoiceFile> choice_file;
+            std::optional<std::pair<T, T>> range;
+            std::vector<std::pair<std::function<bool(const T&)>, std::string>>
+                predicates;
+        };
+
+        /**
+         * @brief Default value generator and the copy of the default value
+         * that resetValue() restores, only allocated if the option has a
+         * default value.
+         *
+         */
+        struct Defaults
+        {
+            std::function<T()> generator;
+            std::optional<T> value;
+        };
+
+        detail::StringArena* m_strings;
+        std::unique_ptr<Validators> m_validators;
+        std::unique_ptr<Defaults> m_defaults;
+        std::function<void(const T&)> m_callback;
+        detail::ValueStorage::Container<T>* m_storage;
+        size_t m_slot;
+        T* m_ref{nullptr};
+
+        std::string_view intern(const OptionName& text)
+        {
+            return text.is_static ? text.value : m_strings->intern(text.value);
+        }
+
+        [[nodiscard]] const T& get() const
+        {
+            return m_ref != nullptr ? *m_ref : (*m_storage)[m_slot];
+        }
+
+        void assign(T&& new_value) { value() = std::move(new_value); }
+
+        void keepDefault(const T& default_value)
+        {
+            // types that cannot be copied are reset to T{}
+            if constexpr (std::is_copy_assignable_v<T>)
+            {
+                defaults().value = default_value;
+            }
+        }
+
+        void setValue(std::string_view value, bool validate) override
+        {
+            if (!validate || !m_validators)
+            {
+                // nothing to validate, parse straight into the storage
+                convert(value, this->value());
+                return;
+            }
+
+            const auto& choice_file = m_validators->choice_file;
+            if (choice_file && !choice_file->contains(value))
+            {
+                throw ArgumentParserException(ErrorKind::ValueNotAllowed, this,
+                                              value);
+            }
+
+            T parsed_value{};
+            convert(value, parsed_value);
+            if (!isAllowed(parsed_value))
+            {
+                throw ArgumentParserException(ErrorKind::ValueNotAllowed, this,
+                                              value);
+            }
+
+            auto failure = violation(parsed_value);
+            if (!failure.empty())
+            {
+                throw ArgumentParserException(ErrorKind::ValidationFailed, this,
+                                              value, failure);
+            }
+            assign(std::move(parsed_value));
+        }
+
+        Validators& validators()
+        {
+            if (!m_validators)
+            {
+                m_validators = std::make_unique<Validators>();
+            }
+            return *m_validators;
+        }
+
+        Defaults& defaults()
+        {
+            if (!m_defaults)
+            {
+                m_defaults = std::make_unique<Defaults>();
+            }
+            return *m_defaults;
+        }
+
+        /**
+         * @brief Runs the validators on a converted value. Returns the
+         * description of the first violated requirement or an empty view.
+         *
+         */
+        std::string_view violation(const T& value) const
+        {
+            if (!m_validators)
+            {
+                return {};
+            }
+
+            if constexpr (detail::IsLessComparable<T>::value)
+            {
+                const auto& range = m_validators->range;
+                if (range && (value < range->first || range->second < value))
+                {
+                    return "is out of range";
+                }
+            }
+
+            for (const auto& [predicate, message] : m_validators->predicates)
+            {
+                if (!predicate(value))
+                {
+                    return message;
+                }
+            }
+            return {};
+        }
+
+        void convert(std::string_view text, T& value) const
+        {
+            auto ec = detail::convert(text, value);
+            if (ec != std::errc{})
+            {
+                throw ArgumentParserException(ErrorKind::InvalidValue, this,
+                                              text, {}, ec);
+            }
+        }
+
+        bool isAllowed(const T& value) const
+        {
+            if constexpr (detail::IsLessComparable<T>::value)
+            {
+                return !m_validators || m_validators->choices.empty() ||
+                       m_validators->choices.count(value) != 0;
+            }
+            else
+            {
+                return true;
+            }
+        }
+
+        [[nodiscard]] bool isPositionalOption() const override
+        {
+            return !long_option.empty() && short_option.empty() &&
+                   long_option.at(0) != '-';
+        }
+
+        std::set<std::string> choices() override
+        {
+            std::set<std::string> result;
+            if constexpr (detail::IsStreamable<T>::value)
+            {
+                if (!m_validators)
+                {
+                    return result;
+                }
+                std::ostringstream oss;
+                for (const auto& allowed_value : m_validators->choices)
+                {
+                    oss << allowed_value;
+                    result.insert(oss.str());
+                    oss.str("");
+                }
+            }
+            return result;
+        }
+
+        void applyLazyDefault() override
+        {
+            if (m_defaults && m_defaults->generator)
+            {
+                T value = m_defaults->generator();
+                keepDefault(value);
+                assign(std::move(value));
+                // memoized, the value is now an ordinary default value
+                m_defaults->generator = nullptr;
+                Option::has_lazy_default = false;
+            }
+        }
+
+        void resetValue() override
+        {
+            if constexpr (std::is_copy_assignable_v<T>)
+            {
+                if (m_defaults && m_defaults->value)
+                {
+                    value() = *m_defaults->value;
+                    return;
+                }
+            }
+            value() = T{};
+        }
+
+        [[nodiscard]] uint64_t hashValidators(uint64_t hash) const override
+        {
+            if (!m_validators)
+            {
+                return hash;
+            }
+
+            if constexpr (detail::IsLessComparable<T>::value)
+            {
+                const auto& range = m_validators->range;
+                if (range)
+                {
+                    hash = hashValue(range->first, hash);
+                    hash = hashValue(range->second, hash);
+                }
+            }
+
+            // captured state, e.g. the regex of pattern(), is not covered
+            for (const auto& [predicate, message] : m_validators->predicates)
+            {
+                hash = detail::fnv1a(predicate.target_type().name(), hash);
+                hash = detail::fnv1a(message, hash);
+                hash = detail::fnv1a({"\0", 1}, hash);
+            }
+            return hash;
+        }
+
+        static uint64_t hashValue(const T& value, uint64_t hash)
+        {
+            std::string text;
+            if constexpr (ValueCodec<T>::supported)
+            {
+                ValueCodec<T>::encode(value, text);
+            }
+            else if constexpr (detail::IsStreamable<T>::value)
+            {
+                std::ostringstream oss;
+                oss << value;
+                text = oss.str();
+            }
+            hash = detail::fnv1a(text, hash);
+            return detail::fnv1a({"\0", 1}, hash);
+        }
+
+        void invokeCallback() override
+        {
+            if (m_callback)
+            {
+                m_callback(get());
+            }
+        }
+
+        [[nodiscard]] const char* typeName() const override
+        {
+            return typeid(T).name();
+        }
+
+        bool encodeValue(std::string& out) const override
+        {
+            if constexpr (ValueCodec<T>::supported)
+            {
+                ValueCodec<T>::encode(get(), out);
+                return true;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        bool decodeValue(std::string_view& in, bool apply) override
+        {
+            if constexpr (ValueCodec<T>::supported)
+            {
+                T value{};
+                if (!ValueCodec<T>::decode(in, apply ? &value : nullptr))
+                {
+                    return false;
+                }
+                if (apply)
+                {
+                    assign(std::move(value));
+                }
+                return true;
+            }
+            else
+            {
+                return false;
+            }
+        }
+    };
+
+    /**
+     * @brief Event produced by the Tokenizer for one or two command line
+     * arguments.
+     *
+     */
+    struct Event
+    {
+        enum class Kind
+        {
+            // an option and its value, the value is empty for flags
+            // without inline value
+            Option,
+            // an argument that is not an option
+            Positional,
+            // the "--" separator, all following arguments are positional
+            EndOfOptions
+        };
+
+        Kind kind;
+        // index of the option in registration order, only for Kind::Option
+        size_t option;
+        // inline (--option=value) or next argument value, or the positional
+        // argument. Views the fed argument.
+        std::string_view value;
+        // index of the argument that started the event
+        size_t argument;
+    };
+
+    /**
+     * @brief Splits command line arguments into events using the options
+     * registered in a parser. Throws on unknown options and missing values but
+     * never stores values or invokes callbacks.
+     *
+     */
+    class Tokenizer
+    {
+    public:
+        explicit Tokenizer(const ArgumentParser& parser) : m_parser{&parser}
+        {
+        }
+
+        /**
+         * @brief Processes the next argument. Returns an event once it is
+         * complete, options that expect a value complete with the next
+         * argument.
+         *
+         * @param token Command line argument.
+         * @return std::optional<Event>
+         */
+        std::optional<Event> push(std::string_view token)
+        {
+            size_t argument = m_arguments++;
+            const auto& options_map = m_parser->m_options_map;
+
+            if (m_pending != NoOption)
+            {
+                auto idx = m_pending;
+                m_pending = NoOption;
+
+                // check if the value is a option, thus the previous option
+                // with arguments was not satisfied.
+                if (options_map.find(token) != detail::NameIndex::npos)
+                {
+                    expectedArgument(idx, argument - 1);
+                }
+                return Event{Event::Kind::Option, idx, token, argument - 1};
+            }
+
+            if (m_end_of_options)
+            {
+                return Event{Event::Kind::Positional, NoOption, token,
+                             argument};
+            }
+
+            if (token == "--")
+            {
+                m_end_of_options = true;
+                return Event{Event::Kind::EndOfOptions, NoOption, {},
+                             argument};
+            }
+
+            auto idx = options_map.find(token);
+            auto equal_sign_pos = token.find('=');
+            std::string_view value;
+            if (idx == NoOption && equal_sign_pos != std::string_view::npos)
+            {
+                // option of type <option>=<value>
+                idx = options_map.find(token.substr(0, equal_sign_pos));
+                if (idx != NoOption)
+                {
+                    value = token.substr(equal_sign_pos + 1);
+                }
+            }
+
+            if (idx != NoOption)
+            {
+                if (value.data() == nullptr && !m_parser->m_options[idx]->flag)
+                {
+                    // the next argument is the value
+                    m_pending = idx;
+                    return {};
+                }
+                return Event{Event::Kind::Option, idx, value, argument};
+            }
+
+            if (!token.empty() && token.front() == '-')
+            {
+                CLAPP_PROBE(validation__failure, NoOption,
+                            static_cast<int>(ErrorKind::UnknownOption));
+                throw ArgumentParserException(ErrorKind::UnknownOption,
+                                              nullptr,
+                                              token.substr(0, equal_sign_pos))
+                    .at(NoOption, argument);
+            }
+
+            return Event{Event::Kind::Positional, NoOption, token, argument};
+        }
+
+        /**
+         * @brief Counts an argument without processing it.
+         *
+         */
+        void skip() { ++m_arguments; }
+
+        /**
+         * @brief Must be called after the last argument. Throws if an option
+         * is still waiting for its value.
+         *
+         */
+        void finish() const
+        {
+            if (m_pending != NoOption)
+            {
+                expectedArgument(m_pending, m_arguments - 1);
+            }
+        }
+
+        /**
+         * @brief Number of arguments pushed so far.
+         *
+         */
+        [[nodiscard]] size_t arguments() const { return m_arguments; }
+
+    private:
+        const ArgumentParser* m_parser;
+        size_t m_pending = NoOption;
+        size_t m_arguments = 0;
+        bool m_end_of_options = false;
+
+        [[noreturn]] void expectedArgument(size_t idx, size_t argument) const
+        {
+            CLAPP_PROBE(validation__failure, idx,
+                        static_cast<int>(ErrorKind::MissingValue));
+            throw ArgumentParserException(ErrorKind::MissingValue,
+                                          m_parser->m_options[idx].get())
+                .at(idx, argument);
+        }
+    };
+
+    /**
+     * @brief Input range of the events of a sequence of arguments. Events are
+     * produced while iterating.
+     *
+     * @tparam Iterator Iterator over values convertible to std::string_view.
+     */
+    template <typename Iterator> class EventStream
+    {
+    public:
+        class iterator
+        {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = Event;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const Event*;
+            using reference = const Event&;
+
+            iterator() = default;
+            explicit iterator(EventStream* stream) : m_stream{stream}
+            {
+                advance();
+            }
+
+            reference operator*() const { return *m_stream->m_event; }
+            pointer operator->() const { return &*m_stream->m_event; }
+
+            iterator& operator++()
+            {
+                advance();
+                return *this;
+            }
+
+            bool operator==(const iterator& other) const
+            {
+                return m_stream == other.m_stream;
+            }
+            bool operator!=(const iterator& other) const
+            {
+                return !(*this == other);
+            }
+
+        private:
+            EventStream* m_stream = nullptr;
+
+            void advance()
+            {
+                if (!m_stream->next())
+                {
+                    m_stream = nullptr;
+                }
+            }
+        };
+
+        EventStream(const ArgumentParser& parser, Iterator first,
+                    Iterator last)
+            : m_tokenizer{parser}, m_first{first}, m_last{last}
+        {
+        }
+
+        iterator begin() { return iterator{this}; }
+        iterator end() { return {}; }
+
+    private:
+        Tokenizer m_tokenizer;
+        Iterator m_first;
+        Iterator m_last;
+        std::optional<Event> m_event;
+
+        bool next()
+        {
+            m_event.reset();
+            while (!m_event && m_first != m_last)
+            {
+                m_event = m_tokenizer.push(std::string_view(*m_first));
+                ++m_first;
+            }
+            if (!m_event)
+            {
+                m_tokenizer.finish();
+            }
+            return m_event.has_value();
+        }
+    };
+
+    /**
+     * @brief Events of the given arguments. Does not modify the options.
+     *
+     * @param first First argument, without the program name.
+     * @param last End of the arguments.
+     */
+    template <typename Iterator>
+    EventStream<Iterator> events(Iterator first, Iterator last) const
+    {
+        return {*this, first, last};
+    }
+
+    /**
+     * @brief Events of the arguments passed to the constructor.
+     *
+     */
+    auto events() const
+    {
+        return events(m_argv.begin() + std::min<size_t>(1, m_argv.size()),
+                      m_argv.end());
+    }
+
+    /**
+     * @brief Parser without arguments. Use feed() and finish() to pass the
+     * command line arguments one at a time.
+     *
+     */
+    ArgumentParser() = default;
+    ArgumentParser(int argc, char* argv[]) : m_argv{argv, argv + argc} {}
+    explicit ArgumentParser(const std::vector<std::string>& arguments)
+        : m_argv{arguments}
+    {
+    }
+
+    /**
+     * @brief Parses the arguments, stores the values and invokes callbacks.
+     * Options that are not specified hold their default value, also when the
+     * parser is reused.
+     *
+     */
+    bool parse()
+    {
+        beginTokens();
+        uint64_t key = 0;
+        bool result = false;
+        try
+        {
+            if (m_verdict_cache)
+            {
+                key = validationKey();
+                m_trusted = m_verdict_cache->contains(key);
+            }
+
+            for (size_t i = 1; i < m_argv.size() && !m_overruled; ++i)
+            {
+                feed(m_argv[i]);
+            }
+            result = finish();
+        }
+        catch (...)
+        {
+            endTokens(false);
+            throw;
+        }
+        if (result && m_verdict_cache && !m_trusted)
+        {
+            m_verdict_cache->insert(key);
+        }
+        return result;
+    }
+
+    /**
+     * @brief Splits a command line string with CommandLineSplitter and parses
+     * the arguments. The first argument is the program name.
+     *
+     * @param command_line Whole command line including the program name.
+     */
+    bool parse(std::string_view command_line)
+    {
+        CommandLineSplitter splitter(command_line);
+        std::string_view argument;
+        if (splitter.next(argument) && m_argv.empty())
+        {
+            m_argv.emplace_back(argument);
+            m_help_fingerprint.reset();
+        }
+
+        beginTokens();
+        while (!m_overruled && splitter.next(argument))
+        {
+            feed(argument);
+        }
+
+        if (splitter.unterminated())
+        {
+            endTokens(false);
+            throw ArgumentParserException(
+                "Unterminated quote in command line.");
+        }
+        return finish();
+    }
+
+    /**
+     * @brief Feeds the next command line argument to the parser. The value is
+     * converted and validated immediately, errors are thrown as soon as the
+     * offending argument is fed and end the parse, the next feed() starts a
+     * new one. Arguments after an overruling option are ignored. Call finish()
+     * after the last argument.
+     *
+     * @param token Command line argument without the program name.
+     */
+    void feed(std::string_view token)
+    {
+        beginTokens();
+        if (m_overruled)
+        {
+            m_tokenizer->skip();
+            return;
+        }
+
+        try
+        {
+            if (auto event = m_tokenizer->push(token))
+            {
+                processEvent(*event);
+            }
+        }
+        catch (...)
+        {
+            endTokens(false);
+            throw;
+        }
+    }
+
+    /**
+     * @brief Completes parsing of the arguments passed to feed(). Applies
+     * environment and config file values, runs the checks and invokes
+     * callbacks like parse().
+     *
+     */
+    bool finish()
+    {
+        beginTokens();
+        try
+        {
+            auto tokenizer = std::move(*m_tokenizer);
+            m_tokenizer.reset();
+            if (!m_overruled)
+            {
+                tokenizer.finish();
+            }
+
+            // an overruling option on the command line skips the other
+            // sources
+            if (!m_overruled)
+            {
+                applyLayeredValues();
+            }
+
+            if (tokenizer.arguments() == 0 && m_option_order.empty())
+            {
+                printHelp();
+                endTokens(false);
+                return false;
+            }
+
+            if (checkOverrulingOptions())
+            {
+                endTokens(false);
+                return false;
+            }
+
+            checkRequiredOptions();
+            checkConstraints();
+            applyLazyDefaults();
+            m_parsed = true;
+            invokeCallbacks();
+        }
+        catch (...)
+        {
+            endTokens(false);
+            throw;
+        }
+        endTokens(true);
+        return true;
+    }
+
+    /**
+     * @brief Parses the given arguments without running their side effects,
+     * e.g. the command line of another process. Values are converted and
+     * checked like in parse(), but environment variables, config files, lazy
+     * defaults, file prefetching and callbacks are skipped. Options specified
+     * in the previous run are reset to their default value first, so no
+     * values leak from one command line into the next. Options with a lazy
+     * default are reset to T{} until the generator ran once. Values are
+     * written into the storage and store() targets like in parse(). Throws
+     * ArgumentParserException if the arguments are invalid.
+     *
+     * @param first First argument, without the program name.
+     * @param last End of the arguments.
+     */
+    template <typename Iterator> void validate(Iterator first, Iterator last)
+    {
+        // discard the state of a previous run that failed
+        m_tokenizer.reset();
+        m_validating = true;
+        try
+        {
+            beginTokens();
+            for (; first != last && !m_overruled; ++first)
+            {
+                if (auto event = m_tokenizer->push(std::string_view(*first)))
+                {
+                    processEvent(*event);
+                }
+            }
+
+            auto tokenizer = std::move(*m_tokenizer);
+            m_tokenizer.reset();
+            if (!m_overruled)
+            {
+                tokenizer.finish();
+                checkRequiredOptions();
+                checkConstraints();
+            }
+        }
+        catch (...)
+        {
+            m_validating = false;
+            endTokens(false);
+            throw;
+        }
+        m_validating = false;
+        endTokens(true);
+    }
+
+    /**
+     * @brief True if the option was specified in the last parse or
+     * validation, including through the environment or a config file.
+     *
+     * @param name Name of a registered option.
+     */
+    [[nodiscard]] bool specified(const std::string& name) const
+    {
+        return m_set.test(optionIndex(name));
+    }
+
+    /**
+     * @brief Serializes the parsed and validated state into a compact binary
+     * blob that can be loaded with restore(). Must be called after parse()
+     * returned true. All set options must have a ValueCodec.
+     *
+     * @return std::string
+     */
+    std::string snapshot() const
+    {
+        if (!m_parsed)
+        {
+            throw ArgumentParserException(
+                "Snapshot requires successfully parsed arguments.");
+        }
+
+        std::string out;
+        out.append(SnapshotMagic, sizeof(SnapshotMagic));
+        ValueCodec<uint32_t>::encode(SnapshotVersion, out);
+        ValueCodec<uint64_t>::encode(fingerprint(), out);
+        ValueCodec<uint32_t>::encode(static_cast<uint32_t>(m_options.size()),
+                                     out);
+
+        for (auto set_bits : m_set.words())
+        {
+            ValueCodec<uint64_t>::encode(set_bits, out);
+        }
+
+        ValueCodec<uint32_t>::encode(
+            static_cast<uint32_t>(m_option_order.size()), out);
+        for (auto idx : m_option_order)
+        {
+            ValueCodec<uint32_t>::encode(static_cast<uint32_t>(idx), out);
+        }
+
+        for (size_t idx = 0; idx < m_options.size(); ++idx)
+        {
+            if (m_set.test(idx) && !m_options[idx]->encodeValue(out))
+            {
+                throw ArgumentParserException("Option '" +
+                                              m_options[idx]->name() +
+                                              "' cannot be serialized.");
+            }
+        }
+        return out;
+    }
+
+    /**
+     * @brief Loads a blob created by snapshot() without tokenizing or
+     * validating arguments again. Values are written to store() targets and
+     * callbacks are invoked in the recorded order, options that are not in
+     * the blob are reset to their default value. Returns false without
+     * modifying the parser if the blob does not match the registered options,
+     * in which case parse() should be used instead.
+     *
+     * @param blob Data returned by snapshot().
+     */
+    bool restore(std::string_view blob)
+    {
+        joinCallbacks();
+
+        // validate the whole blob before anything is applied
+        if (!readSnapshot(blob, false))
+        {
+            return false;
+        }
+
+        // the blob replaces the values of the previous run
+        resetValues();
+        readSnapshot(blob, true);
+        applyLazyDefaults();
+        m_parsed = true;
+        invokeCallbacks();
+        return true;
+    }
+
+    /**
+     * @brief Hash over the names, types and properties of all registered
+     * options, including their range() bounds and validate() predicates.
+     * Used to detect incompatible snapshots and validation cache entries.
+     * Predicates are identified by their type and message, a change of their
+     * captured state, e.g. the regex of pattern(), is not detected.
+     *
+     * @return uint64_t
+     */
+    uint64_t fingerprint() const
+    {
+        uint64_t hash = detail::fnv1a({});
+        for (const auto& option : m_options)
+        {
+            hash = detail::fnv1a(option->short_option, hash);
+            hash = detail::fnv1a({"\0", 1}, hash);
+            hash = detail::fnv1a(option->long_option, hash);
+            hash = detail::fnv1a({"\0", 1}, hash);
+            hash = detail::fnv1a(option->typeName(), hash);
+            char properties[] = {char(option->flag), char(option->required),
+                                 char(option->overruling),
+                                 char(option->has_default_value)};
+            hash = detail::fnv1a({properties, sizeof(properties)}, hash);
+            for (const auto& choice : option->choices())
+            {
+                hash = detail::fnv1a(choice, hash);
+                hash = detail::fnv1a({"\0", 1}, hash);
+            }
+            hash = detail::fnv1a(option->choices_file, hash);
+            hash = option->hashValidators(hash);
+        }
+        for (const auto& constraint : m_constraints)
+        {
+            char kind = static_cast<char>(constraint.kind);
+            hash = detail::fnv1a({&kind, 1}, hash);
+            hash = detail::fnv1a(std::to_string(constraint.option), hash);
+            for (auto word : constraint.mask.words())
+            {
+                hash = detail::fnv1a(
+                    {reinterpret_cast<const char*>(&word), sizeof(word)}, hash);
+            }
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Hash over everything help() renders: the program name, version
+     * and description and the names, texts, choices and properties of all
+     * options. Used to check the text passed to prerenderedHelp().
+     *
+     * @return uint64_t
+     */
+    uint64_t helpFingerprint() const
+    {
+        auto add = [](std::string_view text, uint64_t hash)
+        { return detail::fnv1a({"\0", 1}, detail::fnv1a(text, hash)); };
+
+        uint64_t hash = detail::fnv1a({});
+        hash = add(m_name, hash);
+        hash = add(m_version, hash);
+        hash = add(m_description, hash);
+        hash = add(executableName(), hash);
+        for (const auto& option : m_options)
+        {
+            hash = add(option->short_option, hash);
+            hash = add(option->long_option, hash);
+            hash = add(option->argument_name, hash);
+            hash = add(option->description, hash);
+            hash = add(option->default_placeholder, hash);
+            hash = add(option->choices_file, hash);
+            char properties[] = {char(option->required),
+                                 char(option->isPositionalOption())};
+            hash = detail::fnv1a({properties, sizeof(properties)}, hash);
+            auto choices = option->choices();
+            hash = add(std::to_string(choices.size()), hash);
+            for (const auto& choice : choices)
+            {
+                hash = add(choice, hash);
+            }
+        }
+        return hash;
+    }
+
+    /**
+     * @brief At most one of the given options may be specified.
+     *
+     * @param names Names of registered options.
+     * @return ArgumentParser&
+     */
+    ArgumentParser& mutuallyExclusive(std::initializer_list<std::string> names)
+    {
+        m_constraints.push_back(
+            {Constraint::Kind::MutuallyExclusive, 0, optionMask(names)});
+        return *this;
+    }
+
+    /**
+     * @brief At least one of the given options must be specified.
+     *
+     * @param names Names of registered options.
+     * @return ArgumentParser&
+     */
+    ArgumentParser& atLeastOneOf(std::initializer_list<std::string> names)
+    {
+        m_constraints.push_back(
+            {Constraint::Kind::AtLeastOneOf, 0, optionMask(names)});
+        return *this;
+    }
+
+    /**
+     * @brief If the option is specified, all of the given options must be
+     * specified as well.
+     *
+     * @param name Name of a registered option.
+     * @param names Names of registered options.
+     * @return ArgumentParser&
+     */
+    ArgumentParser& requiresAllOf(const std::string& name,
+                                  std::initializer_list<std::string> names)
+    {
+        m_constraints.push_back({Constraint::Kind::RequiresAllOf,
+                                 optionIndex(name), optionMask(names)});
+        return *this;
+    }
+
+    /**
+     * @brief The callback of the option is invoked after the callbacks of the
+     * given options have completed. Applies to sequential and parallel
+     * dispatch.
+     *
+     * @param name Name of a registered option.
+     * @param names Names of registered options.
+     * @return ArgumentParser&
+     */
+    ArgumentParser& callbackAfter(const std::string& name,
+                                  std::initializer_list<std::string> names)
+    {
+        auto idx = optionIndex(name);
+        auto mask = optionMask(names);
+        if (m_callback_after.size() <= idx)
+        {
+            m_callback_after.resize(m_options.size());
+        }
+        for (auto other = mask.find(mask, false); other != detail::Bitset::npos;
+             other = mask.find(mask, false, other + 1))
+        {
+            m_callback_after[idx].set(other);
+        }
+        return *this;
+    }
+
+#ifdef CLAPP_ENABLE_THREADS
+    /**
+     * @brief Invokes the callbacks on the given number of worker threads
+     * instead of sequentially. parse() returns once the callbacks have been
+     * started, waitForCallbacks() waits for them to complete and reports
+     * their failures. Callbacks that depend on a failed callback are skipped.
+     * 0 restores sequential dispatch. Requires CLAPP_ENABLE_THREADS.
+     *
+     * @param threads Number of worker threads.
+     * @return ArgumentParser&
+     */
+    ArgumentParser& parallelCallbacks(size_t threads)
+    {
+        m_callback_threads = threads;
+        return *this;
+    }
+#endif
+
+    /**
+     * @brief Enables a persistent cache of validation results. parse()
+     * remembers command lines that passed validation. When the same command
+     * line is parsed again, the values are only converted, the choices and
+     * validators are not run again. The key covers the arguments, the
+     * environment variables and config file values of the options, the
+     * fingerprint() and the modification time and size of the given files
+     * and of every argument that names a file. Any change falls back to full
+     * validation. The key does not cover the code or captured state of
+     * validate() predicates, see fingerprint(), use a new cache path when
+     * they change.
+     *
+     * @param path Path of the cache file.
+     * @param files Additional files the validators depend on.
+     * @return ArgumentParser&
+     */
+    ArgumentParser& validationCache(const std::string& path,
+                                    std::vector<std::string> files = {})
+    {
+        m_verdict_cache = std::make_unique<detail::VerdictCache>(path);
+        m_verdict_files = std::move(files);
+        return *this;
+    }
+
+    /**
+     * @brief Waits until the files of options with Prefetch::Read have been
+     * read into the page cache.
+     *
+     */
+    void waitForPrefetch()
+    {
+#ifdef CLAPP_ENABLE_THREADS
+        if (m_prefetcher)
+        {
+            m_prefetcher->wait();
+        }
+#endif
+    }
+
+    /**
+     * @brief Waits for callbacks started by parallel dispatch. Rethrows the
+     * exception of the first failed callback in the order the options were
+     * specified. Failures are only reported here, a new parse() or restore()
+     * waits for running callbacks and discards their failures.
+     *
+     */
+    void waitForCallbacks()
+    {
+#ifdef CLAPP_ENABLE_THREADS
+        if (!m_dispatch)
+        {
+            return;
+        }
+
+        auto dispatch = std::move(m_dispatch);
+        dispatch->join();
+        for (size_t task = 0; task < dispatch->size(); ++task)
+        {
+            if (auto error = dispatch->error(task))
+            {
+                std::rethrow_exception(error);
+            }
+        }
+#endif
+    }
+
+    /**
+     * @brief Loads option values from a key=value (INI-style) config file.
+     * Keys are option names with or without leading dashes, [section] headers
+     * prefix the keys that follow with "section.". Lines starting with '#' or
+     * ';' are comments. Values given on the command line or through an
+     * environment variable take precedence over config files, later files
+     * take precedence over earlier ones. All options must be registered
+     * before loading.
+     *
+     * @param path Path of the config file.
+     * @return ArgumentParser&
+     */
+    ArgumentParser& configFile(const std::string& path)
+    {
+        detail::FileMapping mapping;
+        if (!mapping.open(path))
+        {
+            throw ArgumentParserException("Cannot read config file '" + path +
+                                          "'.");
+        }
+
+        m_config_values.resize(m_options.size());
+        std::string_view content = mapping.view();
+        std::string_view section;
+        size_t line_number = 0;
+        while (!content.empty())
+        {
+            ++line_number;
+            auto line_end = content.find('\n');
+            auto line = detail::trim(content.substr(0, line_end));
+            content.remove_prefix(line_end == std::string_view::npos
+                                      ? content.size()
+                                      : line_end + 1);
+
+            if (line.empty() || line.front() == '#' || line.front() == ';')
+            {
+                continue;
+            }
+
+            if (line.front() == '[' && line.back() == ']')
+            {
+                section = detail::trim(line.substr(1, line.size() - 2));
+                continue;
+            }
+
+            auto equal_sign_pos = line.find('=');
+            auto key = detail::trim(line.substr(0, equal_sign_pos));
+            std::string_view value;
+            if (equal_sign_pos != std::string_view::npos)
+            {
+                value = detail::trim(line.substr(equal_sign_pos + 1));
+                if (value.size() >= 2 && value.front() == '"' &&
+                    value.back() == '"')
+                {
+                    value = value.substr(1, value.size() - 2);
+                }
+            }
+
+            auto idx = findConfigKey(section, key);
+            if (idx == m_options.size())
+            {
+                std::ostringstream oss;
+                oss << "Unknown option '" << key << "' in config file '"
+                    << path << "' (line " << line_number << ").";
+                throw ArgumentParserException(oss.str());
+            }
+
+            if (equal_sign_pos == std::string_view::npos &&
+                !m_options[idx]->flag)
+            {
+                std::ostringstream oss;
+                oss << "Expected value for '" << key << "' in config file '"
+                    << path << "' (line " << line_number << ").";
+                throw ArgumentParserException(oss.str());
+            }
+
+            // keep a non-null view for flags given without a value
+            m_config_values[idx] = value.data() ? value : line.substr(0, 0);
+        }
+
+        m_config_files.push_back(std::move(mapping));
+        return *this;
+    }
+
+    /**
+     * @brief Option that stores a T value.
+     *
+     * @tparam T Some type that has a parseValue() overload, can be constructed
+     * by a string or has a defined TypeParser.
+     * @param short_option Short name of the option.
+     * @param long_option Long name of the option.
+     * @return OptionWrapper<T>&
+     */
+    template <typename T>
+    OptionWrapper<T>& option(OptionName short_option, OptionName long_option)
+    {
+        if (short_option.value.empty() && long_option.value.empty())
+        {
+            throw ArgumentParserException(
+                "Short option and long option name cannot both be empty.");
+        }
+
+        auto intern = [this](const OptionName& name)
+        {
+            return name.is_static ? name.value : m_strings->intern(name.value);
+        };
+        m_options.emplace_back(std::make_unique<OptionWrapper<T>>(
+            *m_values, *m_strings, intern(short_option), intern(long_option)));
+        auto& option_ptr = m_options.back();
+        m_help_fingerprint.reset();
+
+        if (!m_bulk_registration)
+        {
+            indexNames(m_options.size() - 1);
+        }
+
+        return *(reinterpret_cast<OptionWrapper<T>*>(option_ptr.get()));
+    }
+
+    /**
+     * @brief Option that stores a T value.
+     *
+     * @tparam T Some type that has a parseValue() overload, can be constructed
+     * by a string or has a defined TypeParser.
+     * @param long_option Long name of the option.
+     * @return OptionWrapper<T>&
+     */
+    template <typename T> OptionWrapper<T>& option(OptionName long_option)
+    {
+        return option<T>({}, std::move(long_option));
+    }
+
+    /**
+     * @brief Option that acts like a flag and stores a boolean.
+     *
+     * @param short_option Short name of the option.
+     * @param long_option Long name of the option.
+     * @return OptionWrapper<bool>&
+     */
+    OptionWrapper<bool>& option(OptionName short_option,
+                                OptionName long_option)
+    {
+        return option<bool>(std::move(short_option), std::move(long_option));
+    }
+
+    /**
+     * @brief Option that acts like a flag and stores a boolean.
+     *
+     * @param long_option Long name of the option.
+     * @return OptionWrapper<bool>&
+     */
+    OptionWrapper<bool>& option(OptionName long_option)
+    {
+        return option<bool>({}, std::move(long_option));
+    }
+
+    /**
+     * @brief Reserves space for options that are about to be registered.
+     *
+     * @param options Number of options.
+     * @param names Number of short and long names, twice the number of
+     * options if zero.
+     * @param text_bytes Total size of the names and texts that are copied
+     * into the parser, i.e. that are not StaticText, plus one byte each.
+     * @return ArgumentParser&
+     */
+    ArgumentParser& reserve(size_t options, size_t names = 0,
+                            size_t text_bytes = 0)
+    {
+        m_options.reserve(options);
+        m_options_map.reserve(names != 0 ? names : 2 * options);
+        m_strings->reserve(text_bytes);
+        return *this;
+    }
+
+    /**
+     * @brief Registers many options at once. The name index is built once
+     * after register_options returns instead of being updated for every
+     * option. Names cannot be looked up while register_options runs.
+     *
+     * @param register_options Function registering options on this parser.
+     * @return ArgumentParser&
+     */
+    template <typename Function>
+    ArgumentParser& registerOptions(Function&& register_options)
+    {
+        auto first = m_options.size();
+        m_bulk_registration = true;
+        try
+        {
+            std::forward<Function>(register_options)(*this);
+        }
+        catch (...)
+        {
+            m_bulk_registration = false;
+            indexNames(first);
+            throw;
+        }
+        m_bulk_registration = false;
+        indexNames(first);
+        return *this;
+    }
+
+    /**
+     * @brief Returns the help message containing the name and description of
+     * each option.
+     *
+     * @return std::string
+     */
+    std::string help() const
+    {
+        std::stringstream ss;
+        if (!m_name.empty())
+        {
+            ss << m_name;
+            if (m_version.empty())
+            {
+                ss << std::endl;
+            }
+        }
+
+        if (!m_version.empty())
+        {
+            ss << " " << m_version;
+            ss << std::endl;
+        }
+
+        if (!m_description.empty())
+        {
+            ss << m_description << std::endl;
+        }
+
+        if (!m_name.empty() || !m_version.empty() || !m_description.empty())
+        {
+            ss << std::endl;
+        }
+
+        ss << usage();
+        ss << std::endl;
+
+        for (const auto& option : m_options)
+        {
+            if (option->isPositionalOption() && option->description.empty())
+            {
+                continue;
+            }
+
+            if (!option->short_option.empty())
+            {
+                ss << std::setw(2) << std::left << option->short_option;
+            }
+
+            if (!option->long_option.empty())
+            {
+                if (option->short_option.empty())
+                {
+                    ss << std::setw(10) << std::left << option->long_option;
+                }
+                else
+                {
+                    ss << " " << std::right << std::setw(7)
+                       << option->long_option;
+                }
+            }
+
+            if (!option->argument_name.empty())
+            {
+                ss << " <" << option->argument_name << ">";
+            }
+
+            auto choices = option->choices();
+            if (!choices.empty())
+            {
+                ss << " ";
+                for (const auto& choice : choices)
+                {
+                    ss << choice;
+                    if (choice != *(--choices.end()))
+                    {
+                        ss << "|";
+                    }
+                }
+            }
+
+            if (!option->choices_file.empty())
+            {
+                ss << " (one of the values in '" << option->choices_file
+                   << "')";
+            }
+
+            if (!option->default_placeholder.empty())
+            {
+                ss << " (default: " << option->default_placeholder << ")";
+            }
+
+            ss << std::right;
+            if (!option->description.empty())
+            {
+                ss << std::endl;
+                ss << "    " << option->description;
+            }
+            ss << std::endl;
+        }
+        return ss.str();
+    }
+
+    /**
+     * @brief Renders the options as a roff man page.
+     *
+     * @param section Manual section, 1 for user commands.
+     * @return std::string
+     */
+    std::string manPage(int section = 1) const
+    {
+        auto program = programName();
+        std::string upper_program;
+        std::transform(program.begin(), program.end(),
+                       std::back_inserter(upper_program),
+                       [](unsigned char c) { return std::toupper(c); });
+
+        std::stringstream ss;
+        ss << ".TH \"" << roff(upper_program) << "\" \"" << section
+           << "\" \"\" \"" << roff(program);
+        if (!m_version.empty())
+        {
+            ss << " " << roff(m_version);
+        }
+        ss << "\"\n";
+
+        ss << ".SH NAME\n" << roff(program);
+        if (!m_description.empty())
+        {
+            ss << " \\- " << roff(m_description);
+        }
+        ss << "\n.SH SYNOPSIS\n" << roff(detail::trim(usage())) << "\n";
+        if (!m_description.empty())
+        {
+            ss << ".SH DESCRIPTION\n" << roff(m_description) << "\n";
+        }
+
+        ss << ".SH OPTIONS\n";
+        for (const auto& option : m_options)
+        {
+            ss << ".TP\n\\fB" << roff(optionNames(*option)) << "\\fR";
+            if (!option->argument_name.empty() &&
+                !option->isPositionalOption())
+            {
+                ss << " \\fI<" << roff(option->argument_name) << ">\\fR";
+            }
+            ss << "\n";
+            auto text = optionText(*option);
+            ss << (text.empty() ? std::string{} : roff(text) + "\n");
+        }
+        return ss.str();
+    }
+
+    /**
+     * @brief Renders the options as a Markdown document.
+     *
+     * @return std::string
+     */
+    std::string markdown() const
+    {
+        std::stringstream ss;
+        ss << "# " << programName();
+        if (!m_version.empty())
+        {
+            ss << " " << m_version;
+        }
+        ss << "\n\n";
+        if (!m_description.empty())
+        {
+            ss << m_description << "\n\n";
+        }
+
+        ss << "## Synopsis\n\n```\n" << detail::trim(usage()) << "\n```\n\n"
+           << "## Options\n\n";
+        for (const auto& option : m_options)
+        {
+            ss << "- `" << optionNames(*option);
+            if (!option->argument_name.empty() &&
+                !option->isPositionalOption())
+            {
+                ss << " <" << option->argument_name << ">";
+            }
+            ss << "`";
+            auto text = optionText(*option);
+            if (!text.empty())
+            {
+                ss << ": " << text;
+            }
+            ss << "\n";
+        }
+        return ss.str();
+    }
+
+    /**
+     * @brief Help message rendered at build time, see cmake/ClappDocs.cmake.
+     * printHelp() writes the text as is instead of rendering help(). The text
+     * is ignored if fingerprint does not match helpFingerprint(), which
+     * printHelp() computes once, the first time it runs.
+     *
+     * @param text Text returned by help() at build time.
+     * @param fingerprint Value of helpFingerprint() at build time.
+     * @return ArgumentParser&
+     */
+    ArgumentParser& prerenderedHelp(std::string_view text,
+                                    uint64_t fingerprint)
+    {
+        m_prerendered_help = text;
+        m_prerendered_fingerprint = fingerprint;
+        m_help_fingerprint.reset();
+        return *this;
+    }
+
+    /**
+     * @brief Prints the help message containing the name and description of
+     * each option.
+     *
+     */
+    void printHelp() const
+    {
+        if (!m_prerendered_help.empty() && !m_help_fingerprint)
+        {
+            m_help_fingerprint = helpFingerprint();
+        }
+        if (!m_prerendered_help.empty() &&
+            m_prerendered_fingerprint == *m_help_fingerprint)
+        {
+            std::cout.write(m_prerendered_help.data(),
+                            static_cast<std::streamsize>(
+                                m_prerendered_help.size()));
+            return;
+        }
+        std::cout << help();
+    }
+
+    /**
+     * @brief Adds a default option -h (--help).
+     *
+     * @return OptionWrapper<bool>&
+     */
+    auto& addHelp()
+    {
+        return this->option(StaticText("-h"), StaticText("--help"))
+            .flag()
+            .overruling()
+            .description(StaticText("Print this help message."))
+            .callback([this](auto) { this->printHelp(); });
+    }
+
+    /**
+     * @brief Sets the name of the executing program. Displayed in the help
+     * message.
+     *
+     * @param name Name string of the program.
+     * @return ArgumentParser&
+     */
+    ArgumentParser& name(const std::string& name)
+    {
+        m_name = name;
+        m_help_fingerprint.reset();
+        return *this;
+    }
+
+    /**
+     * @brief Sets the description of the executing program. Displayed in the
+     * help message.
+     *
+     * @param description Description string of the program.
+     * @return ArgumentParser&
+     */
+    ArgumentParser& description(const std::string& description)
+    {
+        m_description = description;
+        m_help_fingerprint.reset();
+        return *this;
+    }
+
+    /**
+     * @brief Sets the version of the executing program. Displayed in the help
+     * message.
+     *
+     * @param version Version string of the program.
+     * @return ArgumentParser&
+     */
+    ArgumentParser& version(const std::string& version)
+    {
+        m_version = version;
+        m_help_fingerprint.reset();
+        return *this;
+    }
+
+private:
+    std::string m_name;
+    std::string m_description;
+    std::string m_version;
+
+    std::vector<std::string> m_argv;
+
+    std::string_view m_prerendered_help;
+    uint64_t m_prerendered_fingerprint = 0;
+    // helpFingerprint() of the options, computed by the first printHelp()
+    mutable std::optional<uint64_t> m_help_fingerprint;
+
+    static constexpr size_t NoOption = static_cast<size_t>(-1);
+
+    // tokenizer state shared by parse() and feed()
+    std::optional<Tokenizer> m_tokenizer;
+    bool m_overruled = false;
+    std::vector<size_t> m_positionals;
+
+    detail::NameIndex m_options_map;
+    bool m_bulk_registration = false;
+    std::vector<std::unique_ptr<Option>> m_options;
+    std::vector<size_t> m_option_order;
+    std::unique_ptr<detail::ValueStorage> m_values =
+        std::make_unique<detail::ValueStorage>();
+    // names and descriptions that are not StaticText
+    std::unique_ptr<detail::StringArena> m_strings =
+        std::make_unique<detail::StringArena>();
+
+    bool m_parsed = false;
+    bool m_validating = false;
+    // between parse__start and parse__end
+    bool m_parsing = false;
+
+    // options each callback waits for, indexed by option
+    std::vector<detail::Bitset> m_callback_after;
+    size_t m_callback_threads = 0;
+
+    /**
+     * @brief Relationship between options compiled to a bitmask over the
+     * option indices.
+     *
+     */
+    struct Constraint
+    {
+        enum class Kind : char
+        {
+            MutuallyExclusive,
+            AtLeastOneOf,
+            RequiresAllOf
+        };
+
+        Kind kind;
+        size_t option;
+        detail::Bitset mask;
+    };
+
+    std::vector<Constraint> m_constraints;
+
+    // options specified on the command line, in the environment or in a
+    // config file
+    detail::Bitset m_set;
+    // compiled from the option properties before the checks run
+    detail::Bitset m_required;
+    detail::Bitset m_overruling;
+    detail::Bitset m_defaults;
+
+    static constexpr char SnapshotMagic[4] = {'C', 'L', 'P', 'S'};
+    static constexpr uint32_t SnapshotVersion = 1;
+
+    std::vector<detail::FileMapping> m_config_files;
+    std::vector<std::string_view> m_config_values;
+    std::string m_scratch;
+
+#ifdef CLAPP_ENABLE_THREADS
+    std::unique_ptr<detail::Prefetcher> m_prefetcher;
+#endif
+
+    std::unique_ptr<detail::VerdictCache> m_verdict_cache;
+    std::vector<std::string> m_verdict_files;
+    // set if the current arguments are known to pass validation
+    bool m_trusted = false;
+
+#ifdef CLAPP_ENABLE_THREADS
+    // declared last, running callbacks are joined before the options and
+    // values are destroyed
+    std::unique_ptr<detail::TaskGraph> m_dispatch;
+#endif
+
+    /**
+     * @brief Resolves a config file key to an option index. Returns the
+     * number of options if the key is unknown.
+     *
+     */
+    size_t findConfigKey(std::string_view section, std::string_view key)
+    {
+        for (const char* prefix : {"--", "", "-"})
+        {
+            m_scratch.assign(prefix);
+            if (!section.empty())
+            {
+                m_scratch.append(section).append(".");
+            }
+            m_scratch.append(key);
+
+            auto idx = m_options_map.find(m_scratch);
+            if (idx != detail::NameIndex::npos)
+            {
+                return idx;
+            }
+        }
+        return m_options.size();
+    }
+
+    /**
+     * @brief Assigns values from environment variables and config files to
+     * options that were not given on the command line.
+     *
+     */
+    void applyLayeredValues()
+    {
+        for (size_t idx = 0; idx < m_options.size(); ++idx)
+        {
+            auto& option = m_options[idx];
+            if (m_set.test(idx))
+            {
+                continue;
+            }
+
+            const char* env_value =
+                option->env_variable.empty()
+                    ? nullptr
+                    : std::getenv(option->env_variable.data());
+            if (env_value != nullptr)
+            {
+                assignValue(idx, env_value);
+            }
+            else if (idx < m_config_values.size() &&
+                     m_config_values[idx].data() != nullptr)
+            {
+                assignValue(idx, m_config_values[idx]);
+            }
+        }
+    }
+
+    /**
+     * @brief Reads a snapshot blob. Only checks that the blob is well-formed
+     * and matches the registered options unless apply is true.
+     *
+     */
+    bool readSnapshot(std::string_view in, bool apply)
+    {
+        if (in.size() < sizeof(SnapshotMagic) ||
+            std::memcmp(in.data(), SnapshotMagic, sizeof(SnapshotMagic)) != 0)
+        {
+            return false;
+        }
+        in.remove_prefix(sizeof(SnapshotMagic));
+
+        uint32_t version = 0;
+        uint64_t hash = 0;
+        uint32_t option_count = 0;
+        if (!ValueCodec<uint32_t>::decode(in, &version) ||
+            version != SnapshotVersion ||
+            !ValueCodec<uint64_t>::decode(in, &hash) ||
+            !ValueCodec<uint32_t>::decode(in, &option_count) ||
+            option_count != m_options.size() ||
+            (!apply && hash != fingerprint()))
+        {
+            return false;
+        }
+
+        detail::Bitset set_options;
+        set_options.resize(m_options.size());
+        for (auto& set_bits : set_options.words())
+        {
+            if (!ValueCodec<uint64_t>::decode(in, &set_bits))
+            {
+                return false;
+            }
+        }
+
+        uint32_t order_count = 0;
+        if (!ValueCodec<uint32_t>::decode(in, &order_count))
+        {
+            return false;
+        }
+        if (apply)
+        {
+            m_option_order.clear();
+        }
+        for (uint32_t i = 0; i < order_count; ++i)
+        {
+            uint32_t idx = 0;
+            if (!ValueCodec<uint32_t>::decode(in, &idx) ||
+                idx >= m_options.size())
+            {
+                return false;
+            }
+            if (apply)
+            {
+                m_option_order.push_back(idx);
+            }
+        }
+
+        for (size_t idx = 0; idx < m_options.size(); ++idx)
+        {
+            if (set_options.test(idx) &&
+                !m_options[idx]->decodeValue(in, apply))
+            {
+                return false;
+            }
+        }
+
+        if (apply)
+        {
+            m_set = std::move(set_options);
+        }
+        return in.empty();
+    }
+
+    /**
+     * @brief Adds the names of all options starting at index first to the
+     * name index.
+     *
+     */
+    void indexNames(size_t first)
+    {
+        m_options_map.reserve(m_options_map.size() +
+                              2 * (m_options.size() - first));
+        for (auto idx = first; idx < m_options.size(); ++idx)
+        {
+            const auto& option = m_options[idx];
+            if (!option->short_option.empty())
+            {
+                m_options_map.insert(option->short_option, idx);
+            }
+            if (!option->long_option.empty())
+            {
+                m_options_map.insert(option->long_option, idx);
+            }
+        }
+    }
+
+    /**
+     * @brief Usage line listing the program name and all options. Wrapped
+     * after about 100 characters.
+     *
+     */
+    std::string usage() const
+    {
+        std::stringstream ss;
+        uint32_t line_length = 0;
+        ss << executableName() << " ";
+        for (const auto& option : m_options)
+        {
+            if (line_length > 100)
+            {
+                ss << std::endl << " ";
+                line_length = 0;
+            }
+            assert(!option->short_option.empty() ||
+                   !option->long_option.empty());
+            if (!option->required)
+            {
+                ss << "[";
+            }
+            if (option->isPositionalOption())
+            {
+                if (!option->argument_name.empty())
+                {
+                    ss << "<" << option->argument_name << ">";
+                }
+                else
+                {
+                    ss << option->long_option;
+                }
+            }
+            else
+            {
+                if (!option->short_option.empty())
+                {
+                    ss << option->short_option;
+                }
+                else if (!option->long_option.empty())
+                {
+                    ss << option->long_option;
+                }
+                if (!option->argument_name.empty())
+                {
+                    ss << " <" << option->argument_name << ">";
+                }
+            }
+            auto choices = option->choices();
+            if (!choices.empty())
+            {
+                ss << " ";
+                for (const auto& choice : choices)
+                {
+                    ss << choice;
+                    if (choice != *(--choices.end()))
+                    {
+                        ss << "|";
+                    }
+                }
+            }
+            if (!option->required)
+            {
+                ss << "]";
+            }
+            ss << " ";
+            line_length += ss.str().size();
+        }
+
+        return ss.str();
+    }
+
+    std::string programName() const
+    {
+        return !m_name.empty() ? m_name : std::string(executableName());
+    }
+
+    /**
+     * @brief File name of the program without the directory, the same for
+     * "./build/tool" and "/usr/bin/tool".
+     *
+     */
+    std::string_view executableName() const
+    {
+        if (m_argv.empty())
         {
-            Option::overruling = true;
-            return *this;
+            return {};
         }
+        std::string_view path = m_argv[0];
+        auto slash = path.find_last_of('/');
+        return slash == std::string_view::npos ? path
+                                               : path.substr(slash + 1);
+    }
 
-        /**
-         * @brief Provide values that are allowed to be specified.
-         *
-         * @param values
-         * @return OptionWrapper<T>&
-         */
-        OptionWrapper<T>& choices(std::initializer_list<T> values)
+    static std::string optionNames(const Option& option)
+    {
+        if (option.isPositionalOption())
         {
-            m_choices = values;
-            return *this;
+            return std::string(option.argument_name.empty()
+                                   ? option.long_option
+                                   : option.argument_name);
         }
 
-        /**
-         * @brief Provide values that are allowed to be specified.
-         *
-         * @param values
-         * @return OptionWrapper<T>&
-         */
-        OptionWrapper<T>& choices(const std::set<T>& values)
+        std::string names{option.short_option};
+        if (!option.short_option.empty() && !option.long_option.empty())
         {
-            m_choices = values;
-            return *this;
+            names.append(", ");
         }
+        names.append(option.long_option);
+        return names;
+    }
 
-        /**
-         * @brief Current value stored in the option.
-         *
-         * @return T&
-         */
-        T& value() { return m_value; }
-
-    private:
-        friend class ArgumentParser;
-        std::set<T> m_choices;
-        std::function<void(T)> m_callback = [](T val) {};
-        T m_value;
-        T* m_ref{nullptr};
-
-        void setValue(const std::string& value) override
+    /**
+     * @brief Description of the option followed by its allowed values,
+     * default and whether it is required.
+     *
+     */
+    std::string optionText(Option& option) const
+    {
+        std::stringstream ss;
+        ss << option.description;
+        auto choices = option.choices();
+        if (!choices.empty())
         {
-            if (isAllowedValue(value))
-            {
-                Option::set = true;
-                m_value = TypeParser<T>::Get(value);
-                if (m_ref)
-                    *m_ref = m_value;
-            }
-            else
+            ss << (ss.tellp() > 0 ? " " : "") << "One of:";
+            for (const auto& choice : choices)
             {
-                throw ArgumentParserException("Value '" + value +
-                                              "' not allowed.");
+                ss << " " << choice;
             }
+            ss << ".";
         }
-
-        bool isAllowedValue(const std::string& value) override
+        if (!option.choices_file.empty())
         {
-            if (m_choices.size() == 0)
-            {
-                return true;
-            }
-
-            auto parsed_value = TypeParser<T>::Get(value);
-            if (m_choices.find(parsed_value) != m_choices.end())
-            {
-                return true;
-            }
-
-            return false;
+            ss << (ss.tellp() > 0 ? " " : "") << "One of the values in '"
+               << option.choices_file << "'.";
         }
-
-        [[nodiscard]] bool isPositionalOption() const override
+        if (!option.default_placeholder.empty())
         {
-            return !long_option.empty() && short_option.empty() &&
-                   long_option.at(0) != '-';
+            ss << (ss.tellp() > 0 ? " " : "")
+               << "Default: " << option.default_placeholder << ".";
         }
-
-        std::set<std::string> choices() override
+        if (option.required)
         {
-            std::ostringstream oss;
-            std::set<std::string> result;
-            for (const auto& allowed_value : m_choices)
-            {
-                oss << allowed_value;
-                result.insert(oss.str());
-                oss.str("");
-            }
-            return result;
+            ss << (ss.tellp() > 0 ? " " : "") << "Required.";
         }
-
-        void invokeCallback() override { m_callback(m_value); }
-    };
-
-    ArgumentParser(int argc, char* argv[]) : m_argv{argv, argv + argc} {}
-    explicit ArgumentParser(const std::vector<std::string>& arguments)
-        : m_argv{arguments}
-    {
+        return ss.str();
     }
 
     /**
-     * @brief Parses the arguments, stores the values and invokes callbacks.
+     * @brief Escapes text for roff. Dashes and backslashes are escaped, lines
+     * starting with a control character are protected.
      *
      */
-    bool parse()
+    static std::string roff(std::string_view text)
     {
-        if (m_argv.size() < 2)
+        std::string out;
+        bool line_start = true;
+        for (char c : text)
         {
-            printHelp();
-            return false;
+            if (line_start && (c == '.' || c == '\''))
+            {
+                out.append("\\&");
+            }
+            line_start = c == '\n';
+            switch (c)
+            {
+            case '\\':
+                out.append("\\e");
+                break;
+            case '-':
+                out.append("\\-");
+                break;
+            default:
+                out.push_back(c);
+                break;
+            }
         }
+        return out;
+    }
 
-        parseArguments();
-
-        if (checkOverrulingOptions())
+    size_t optionIndex(const std::string& name) const
+    {
+        auto idx = m_options_map.find(name);
+        if (idx == detail::NameIndex::npos)
         {
-            return false;
+            throw ArgumentParserException("Unknown option '" + name + "'.");
         }
+        return idx;
+    }
 
-        checkRequiredOptions();
-        invokeCallbacks();
-        return true;
+    detail::Bitset optionMask(std::initializer_list<std::string> names) const
+    {
+        detail::Bitset mask;
+        mask.resize(m_options.size());
+        for (const auto& name : names)
+        {
+            mask.set(optionIndex(name));
+        }
+        return mask;
     }
 
     /**
-     * @brief Option that stores a T value.
+     * @brief Key of the validation cache for the arguments passed to the
+     * constructor. Covers the arguments, environment and config values, and
+     * the state of the files they might name, including inline values of
+     * <option>=<value> arguments.
      *
-     * @tparam T Some type that can be constructed by a string or has a defined
-     * TypeParser.
-     * @param short_option Short name of the option.
-     * @param long_option Long name of the option.
-     * @return OptionWrapper<T>&
      */
-    template <typename T>
-    OptionWrapper<T>& option(const std::string& short_option,
-                             const std::string& long_option)
+    uint64_t validationKey() const
     {
-        m_options.emplace_back(
-            std::make_unique<OptionWrapper<T>>(short_option, long_option));
-        auto& option_ptr = m_options.back();
-
-        if (short_option.empty() && long_option.empty())
+        uint64_t hash = fingerprint();
+        auto add_file = [&hash](std::string_view path)
         {
-            throw ArgumentParserException(
-                "Short option and long option name cannot both be empty.");
-        }
+#ifdef CLAPP_HAS_MMAP
+            struct stat st
+            {
+            };
+            uint64_t state[4] = {};
+            if (!path.empty() && ::stat(std::string(path).c_str(), &st) == 0)
+            {
+                state[0] = static_cast<uint64_t>(st.st_mtime);
+#ifdef __APPLE__
+                state[1] = static_cast<uint64_t>(st.st_mtimespec.tv_nsec);
+#else
+                state[1] = static_cast<uint64_t>(st.st_mtim.tv_nsec);
+#endif
+                state[2] = static_cast<uint64_t>(st.st_size);
+                state[3] = static_cast<uint64_t>(st.st_ino);
+            }
+            hash = detail::fnv1a(
+                {reinterpret_cast<const char*>(state), sizeof(state)}, hash);
+#else
+            (void)path;
+#endif
+        };
 
-        if (!short_option.empty())
+        for (size_t i = 1; i < m_argv.size(); ++i)
         {
+            std::string_view argument = m_argv[i];
+            hash = detail::fnv1a(argument, hash);
+            hash = detail::fnv1a({"\0", 1}, hash);
+            add_file(argument);
 
-            m_options_map[short_option] = m_options.size() - 1;
+            auto equal_sign_pos = argument.find('=');
+            if (equal_sign_pos != std::string_view::npos &&
+                m_options_map.find(argument) == detail::NameIndex::npos &&
+                m_options_map.find(argument.substr(0, equal_sign_pos)) !=
+                    detail::NameIndex::npos)
+            {
+                add_file(argument.substr(equal_sign_pos + 1));
+            }
+        }
+        for (const auto& path : m_verdict_files)
+        {
+            add_file(path);
+        }
+        for (const auto& option : m_options)
+        {
+            if (!option->choices_file.empty())
+            {
+                add_file(option->choices_file);
+            }
         }
 
-        if (!long_option.empty())
+        for (size_t idx = 0; idx < m_options.size(); ++idx)
         {
-            m_options_map[long_option] = m_options.size() - 1;
+            const auto& variable = m_options[idx]->env_variable;
+            const char* env_value =
+                variable.empty() ? nullptr : std::getenv(variable.data());
+            if (env_value != nullptr)
+            {
+                hash = detail::fnv1a(env_value, hash);
+                add_file(env_value);
+            }
+            hash = detail::fnv1a({"\0", 1}, hash);
+            if (idx < m_config_values.size())
+            {
+                hash = detail::fnv1a(m_config_values[idx], hash);
+                add_file(m_config_values[idx]);
+            }
+            hash = detail::fnv1a({"\0", 1}, hash);
         }
+        return hash;
+    }
 
-        return *(reinterpret_cast<OptionWrapper<T>*>(option_ptr.get()));
+    /**
+     * @brief Resets the options specified in the previous run to their
+     * default value. Other options still hold their default value.
+     *
+     */
+    void resetValues()
+    {
+        for (size_t idx = 0; idx < m_options.size(); ++idx)
+        {
+            if (m_set.test(idx))
+            {
+                m_options[idx]->resetValue();
+            }
+        }
     }
 
     /**
-     * @brief Option that stores a T value.
+     * @brief Runs the default value generators of options that were not
+     * specified.
      *
-     * @tparam T Some type that can be constructed by a string or has a defined
-     * TypeParser.
-     * @param long_option Long name of the option.
-     * @return OptionWrapper<T>&
      */
-    template <typename T>
-    OptionWrapper<T>& option(const std::string& long_option)
+    void applyLazyDefaults()
     {
-        return option<T>({}, long_option);
+        for (size_t idx = 0; idx < m_options.size(); ++idx)
+        {
+            if (m_options[idx]->has_lazy_default && !m_set.test(idx))
+            {
+                m_options[idx]->applyLazyDefault();
+            }
+        }
     }
 
     /**
-     * @brief Option that acts like a flag and stores a boolean.
+     * @brief Compiles the option properties into bitmasks.
      *
-     * @param short_option Short name of the option.
-     * @param long_option Long name of the option.
-     * @return OptionWrapper<bool>&
      */
-    OptionWrapper<bool>& option(const std::string& short_option,
-                                const std::string& long_option)
+    void compileMasks()
     {
-        return option<bool>(short_option, long_option);
+        m_positionals.clear();
+        m_set.resize(m_options.size());
+        m_required.resize(m_options.size());
+        m_overruling.resize(m_options.size());
+        m_defaults.resize(m_options.size());
+        m_required.clear();
+        m_overruling.clear();
+        m_defaults.clear();
+        for (size_t idx = 0; idx < m_options.size(); ++idx)
+        {
+            const auto& option = m_options[idx];
+            if (option->required)
+            {
+                m_required.set(idx);
+            }
+            if (option->overruling)
+            {
+                m_overruling.set(idx);
+            }
+            if (option->has_default_value)
+            {
+                m_defaults.set(idx);
+            }
+            if (option->isPositionalOption())
+            {
+                m_positionals.push_back(idx);
+            }
+        }
     }
 
     /**
-     * @brief Option that acts like a flag and stores a boolean.
+     * @brief Compiles the option properties and resets the tokenizer state
+     * and the values of the previous run before the first token is fed.
      *
-     * @param long_option Long name of the option.
-     * @return OptionWrapper<bool>&
      */
-    OptionWrapper<bool>& option(const std::string& long_option)
+    void beginTokens()
     {
-        return option<bool>({}, long_option);
+        if (!m_tokenizer)
+        {
+            joinCallbacks();
+            CLAPP_PROBE(parse__start, m_options.size());
+            m_parsing = true;
+            m_parsed = false;
+            m_trusted = false;
+            compileMasks();
+            m_tokenizer.emplace(*this);
+            m_overruled = false;
+            // no values of the previous run, successful or not, carry over
+            resetValues();
+            m_set.clear();
+            m_option_order.clear();
+        }
     }
 
     /**
-     * @brief Returns the help message containing the name and description of
-     * each option.
+     * @brief Ends the parse started by beginTokens(). Does nothing if it
+     * already ended, so failures can be reported on every level.
      *
-     * @return std::string
      */
-    std::string help() const
+    void endTokens([[maybe_unused]] bool success)
     {
-        std::stringstream ss;
-        if (!m_name.empty())
+        m_tokenizer.reset();
+        if (m_parsing)
         {
-            ss << m_name;
-            if (m_version.empty())
-            {
-                ss << std::endl;
-            }
+            m_parsing = false;
+            CLAPP_PROBE(parse__end, success ? 1 : 0);
         }
+    }
 
-        if (!m_version.empty())
+    void assignValue(size_t idx, std::string_view value,
+                     size_t argument = NoOption)
+    {
+        CLAPP_PROBE(convert, idx, value.data(), value.size());
+        try
         {
-            ss << " " << m_version;
-            ss << std::endl;
+            m_options[idx]->setValue(value, !m_trusted);
+        }
+        catch (ArgumentParserException& e)
+        {
+            CLAPP_PROBE(validation__failure, idx, static_cast<int>(e.kind()));
+            e.at(idx, argument);
+            throw;
         }
+        m_set.set(idx);
+        m_option_order.push_back(idx);
 
-        if (!m_description.empty())
+        if (m_options[idx]->prefetch != Prefetch::None && !m_validating)
         {
-            ss << m_description << std::endl;
+            prefetchFile(m_options[idx]->prefetch, std::string(value));
         }
 
-        if (!m_name.empty() || !m_version.empty() || !m_description.empty())
+        if (m_overruling.test(idx))
         {
-            ss << std::endl;
+            // the remaining arguments are irrelevant
+            m_overruled = true;
         }
+    }
 
-        uint32_t size = ss.str().size();
-        uint32_t line_length = size;
-        ss << m_argv[0] << " ";
-        for (const auto& option : m_options)
+    void processEvent(const Event& event)
+    {
+        switch (event.kind)
         {
-            if (line_length > size + 100)
-            {
-                ss << std::endl << " ";
-                line_length = size;
-            }
-            assert(!option->short_option.empty() ||
-                   !option->long_option.empty());
-            if (!option->required)
-            {
-                ss << "[";
-            }
-            if (option->isPositionalOption())
+        case Event::Kind::Option:
+            CLAPP_PROBE(option__match, event.option, event.argument);
+            assignValue(event.option, event.value, event.argument);
+            break;
+        case Event::Kind::Positional:
+            for (auto idx : m_positionals)
             {
-                if (!option->argument_name.empty())
-                {
-                    ss << "<" << option->argument_name << ">";
-                }
-                else
+                if (!m_set.test(idx))
                 {
-                    ss << option->long_option;
+                    assignValue(idx, event.value, event.argument);
+                    break;
                 }
             }
-            else
+            break;
+        case Event::Kind::EndOfOptions:
+            break;
+        }
+    }
+
+    void checkRequiredOptions()
+    {
+        // required options that are neither set nor have a default value
+        for (auto idx = m_required.find(m_set, true);
+             idx != detail::Bitset::npos;
+             idx = m_required.find(m_set, true, idx + 1))
+        {
+            if (!m_defaults.test(idx))
             {
-                if (!option->short_option.empty())
-                {
-                    ss << option->short_option;
-                }
-                else if (!option->long_option.empty())
+                CLAPP_PROBE(validation__failure, idx,
+                            static_cast<int>(ErrorKind::RequiredOption));
+                throw ArgumentParserException(ErrorKind::RequiredOption,
+                                              m_options[idx].get())
+                    .at(idx, NoOption);
+            }
+        }
+    }
+
+    void checkConstraints()
+    {
+        for (const auto& constraint : m_constraints)
+        {
+            switch (constraint.kind)
+            {
+            case Constraint::Kind::MutuallyExclusive:
+                if (m_set.countCommon(constraint.mask) > 1)
                 {
-                    ss << option->long_option;
+                    auto first = constraint.mask.find(m_set, false);
+                    auto second = constraint.mask.find(m_set, false, first + 1);
+                    std::stringstream ss;
+                    ss << "Options '" << m_options[first]->name() << "' and '"
+                       << m_options[second]->name()
+                       << "' are mutually exclusive.";
+                    CLAPP_PROBE(validation__failure, second,
+                                static_cast<int>(ErrorKind::None));
+                    throw ArgumentParserException(ss.str());
                 }
-                if (!option->argument_name.empty())
+                break;
+            case Constraint::Kind::AtLeastOneOf:
+                if (!m_set.intersects(constraint.mask))
                 {
-                    ss << " <" << option->argument_name << ">";
+                    std::stringstream ss;
+                    ss << "One of the options";
+                    const auto& mask = constraint.mask;
+                    for (auto idx = mask.find(mask, false);
+                         idx != detail::Bitset::npos;
+                         idx = mask.find(mask, false, idx + 1))
+                    {
+                        ss << " '" << m_options[idx]->name() << "'";
+                    }
+                    ss << " is required.";
+                    CLAPP_PROBE(validation__failure, NoOption,
+                                static_cast<int>(ErrorKind::None));
+                    throw ArgumentParserException(ss.str());
                 }
-            }
-            auto choices = option->choices();
-            if (!choices.empty())
-            {
-                ss << " ";
-                for (const auto& choice : choices)
+                break;
+            case Constraint::Kind::RequiresAllOf:
+                if (m_set.test(constraint.option))
                 {
-                    ss << choice;
-                    if (choice != *(--choices.end()))
+                    auto missing = constraint.mask.find(m_set, true);
+                    if (missing != detail::Bitset::npos)
                     {
-                        ss << "|";
+                        std::stringstream ss;
+                        ss << "Option '"
+                           << m_options[constraint.option]->name()
+                           << "' requires option '"
+                           << m_options[missing]->name() << "'.";
+                        CLAPP_PROBE(validation__failure, constraint.option,
+                                    static_cast<int>(ErrorKind::None));
+                        throw ArgumentParserException(ss.str());
                     }
                 }
+                break;
             }
-            if (!option->required)
-            {
-                ss << "]";
-            }
-            ss << " ";
-            line_length += ss.str().size() - size;
         }
+    }
 
-        ss << std::endl;
-
-        for (const auto& option : m_options)
+    void invokeCallbacks()
+    {
+        if (m_callback_after.empty() && m_callback_threads == 0)
         {
-            if (option->isPositionalOption() && option->description.empty())
-            {
-                continue;
-            }
-
-            if (!option->short_option.empty())
-            {
-                ss << std::setw(2) << std::left << option->short_option;
-            }
-
-            if (!option->long_option.empty())
+            for (const auto& option_idx : m_option_order)
             {
-                if (option->short_option.empty())
-                {
-                    ss << std::setw(10) << std::left << option->long_option;
-                }
-                else
-                {
-                    ss << " " << std::right << std::setw(7)
-                       << option->long_option;
-                }
+                invokeCallback(*m_options[option_idx], option_idx);
             }
+            return;
+        }
 
-            if (!option->argument_name.empty())
+        // one task per entry of m_option_order
+        auto tasks = m_option_order.size();
+        std::vector<std::vector<size_t>> option_tasks(m_options.size());
+        for (size_t task = 0; task < tasks; ++task)
+        {
+            option_tasks[m_option_order[task]].push_back(task);
+        }
+
+        std::vector<std::vector<size_t>> dependents(tasks);
+        std::vector<size_t> pending(tasks, 0);
+        auto add_dependency = [&](size_t before, size_t task)
+        {
+            dependents[before].push_back(task);
+            ++pending[task];
+        };
+        for (size_t idx = 0; idx < m_options.size(); ++idx)
+        {
+            const auto& own_tasks = option_tasks[idx];
+            // repeated options keep their order
+            for (size_t i = 1; i < own_tasks.size(); ++i)
             {
-                ss << " <" << option->argument_name << ">";
+                add_dependency(own_tasks[i - 1], own_tasks[i]);
+            }
+            if (own_tasks.empty() || idx >= m_callback_after.size())
+            {
+                continue;
             }
 
-            auto choices = option->choices();
-            if (!choices.empty())
+            const auto& after = m_callback_after[idx];
+            for (auto other = after.find(after, false);
+                 other != detail::Bitset::npos;
+                 other = after.find(after, false, other + 1))
             {
-                ss << " ";
-                for (const auto& choice : choices)
+                for (auto before : option_tasks[other])
                 {
-                    ss << choice;
-                    if (choice != *(--choices.end()))
+                    for (auto task : own_tasks)
                     {
-                        ss << "|";
+                        if (before != task)
+                        {
+                            add_dependency(before, task);
+                        }
                     }
                 }
             }
+        }
 
-            ss << std::right;
-            if (!option->description.empty())
+        auto order = callbackOrder(dependents, pending);
+#ifdef CLAPP_ENABLE_THREADS
+        if (m_callback_threads != 0)
+        {
+            std::vector<Option*> options;
+            options.reserve(tasks);
+            for (auto idx : m_option_order)
             {
-                ss << std::endl;
-                ss << "    " << option->description;
+                options.push_back(m_options[idx].get());
             }
-            ss << std::endl;
+            m_dispatch = std::make_unique<detail::TaskGraph>(
+                [options = std::move(options),
+                 order = m_option_order](size_t task)
+                { invokeCallback(*options[task], order[task]); },
+                std::move(dependents), std::move(pending), m_callback_threads);
+            return;
+        }
+#endif
+
+        for (auto task : order)
+        {
+            auto idx = m_option_order[task];
+            invokeCallback(*m_options[idx], idx);
         }
-        return ss.str();
     }
 
     /**
-     * @brief Prints the help message containing the name and description of
-     * each option.
+     * @brief Waits for callbacks started by parallel dispatch of a previous
+     * parse. Their failures are discarded, see waitForCallbacks().
      *
      */
-    void printHelp() const { std::cout << help(); }
+    void joinCallbacks()
+    {
+#ifdef CLAPP_ENABLE_THREADS
+        m_dispatch.reset();
+#endif
+    }
+
+    void prefetchFile(Prefetch policy, std::string path)
+    {
+#ifdef CLAPP_ENABLE_THREADS
+        if (policy == Prefetch::Read)
+        {
+            if (!m_prefetcher)
+            {
+                m_prefetcher = std::make_unique<detail::Prefetcher>();
+            }
+            m_prefetcher->read(std::move(path));
+            return;
+        }
+#else
+        (void)policy;
+#endif
+        detail::adviseReadahead(path);
+    }
+
+    static void invokeCallback(Option& option, [[maybe_unused]] size_t idx)
+    {
+        CLAPP_PROBE(callback__entry, idx);
+        try
+        {
+            option.invokeCallback();
+        }
+        catch (...)
+        {
+            CLAPP_PROBE(callback__exit, idx);
+            throw;
+        }
+        CLAPP_PROBE(callback__exit, idx);
+    }
 
     /**
-     * @brief Adds a default option -h (--help).
+     * @brief Sequential order of the callback tasks that respects the
+     * dependencies and otherwise keeps the order the options were specified.
+     * Throws if the dependencies are cyclic.
      *
-     * @return OptionWrapper<bool>&
      */
-    auto& addHelp()
+    std::vector<size_t>
+    callbackOrder(const std::vector<std::vector<size_t>>& dependents,
+                  std::vector<size_t> pending) const
     {
-        return this->option("-h", "--help")
-            .flag()
-            .overruling()
-            .description("Print this help message.")
-            .callback([this](auto) { this->printHelp(); });
+        std::vector<size_t> ready;
+        std::vector<size_t> order;
+        order.reserve(pending.size());
+        for (size_t task = pending.size(); task-- > 0;)
+        {
+            if (pending[task] == 0)
+            {
+                ready.push_back(task);
+            }
+        }
+
+        // ready is kept sorted in descending order, the next task is the last
+        while (!ready.empty())
+        {
+            auto task = ready.back();
+            ready.pop_back();
+            order.push_back(task);
+            for (auto dependent : dependents[task])
+            {
+                if (--pending[dependent] == 0)
+                {
+                    ready.insert(std::upper_bound(ready.begin(), ready.end(),
+                                                  dependent,
+                                                  std::greater<size_t>()),
+                                 dependent);
+                }
+            }
+        }
+
+        if (order.size() != pending.size())
+        {
+            auto task = std::find_if(pending.begin(), pending.end(),
+                                     [](auto count) { return count != 0; }) -
+                        pending.begin();
+            throw ArgumentParserException(
+                "Callback dependencies of option '" +
+                m_options[m_option_order[task]]->name() + "' form a cycle.");
+        }
+        return order;
+    }
+
+    bool checkOverrulingOptions()
+    {
+        auto idx = m_overruling.find(m_set, false);
+        if (idx != detail::Bitset::npos)
+        {
+            invokeCallback(*m_options[idx], idx);
+            return true;
+        }
+
+        return false;
     }
+};
+
+/* Process inspection */
 
+/**
+ * @brief Command line of a running process read from /proc/<pid>/cmdline.
+ * The arguments are views into a single buffer that is reused by subsequent
+ * loads, so inspecting many processes does not allocate per argument.
+ *
+ */
+class ProcessCommandLine
+{
+public:
     /**
-     * @brief Sets the name of the executing program. Displayed in the help
-     * message.
+     * @brief Reads the command line of the process. Returns false if it
+     * cannot be read, e.g. because the process exited.
      *
-     * @param name Name string of the program.
-     * @return ArgumentParser&
      */
-    ArgumentParser& name(const std::string& name)
+    bool load(int pid)
     {
-        m_name = name;
-        return *this;
+        m_buffer.clear();
+        m_arguments.clear();
+#ifdef CLAPP_HAS_MMAP
+        char path[32];
+        std::snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        // procfs reports a size of 0, read until the end
+        char chunk[4096];
+        ssize_t count = 0;
+        while ((count = ::read(fd, chunk, sizeof(chunk))) > 0)
+        {
+            m_buffer.append(chunk, static_cast<size_t>(count));
+        }
+        ::close(fd);
+        if (count < 0)
+        {
+            return false;
+        }
+        split();
+        return true;
+#else
+        (void)pid;
+        return false;
+#endif
     }
 
     /**
-     * @brief Sets the description of the executing program. Displayed in the
-     * help message.
+     * @brief Uses a copy of a buffer of NUL separated arguments.
      *
-     * @param description Description string of the program.
-     * @return ArgumentParser&
      */
-    ArgumentParser& description(const std::string& description)
+    void assign(std::string_view buffer)
     {
-        m_description = description;
-        return *this;
+        m_buffer.assign(buffer);
+        split();
     }
 
     /**
-     * @brief Sets the version of the executing program. Displayed in the help
-     * message.
+     * @brief All arguments including the program name.
      *
-     * @param version Version string of the program.
-     * @return ArgumentParser&
      */
-    ArgumentParser& version(const std::string& version)
+    [[nodiscard]] const std::vector<std::string_view>& arguments() const
     {
-        m_version = version;
-        return *this;
+        return m_arguments;
+    }
+
+    /**
+     * @brief File name of the program without the directory.
+     *
+     */
+    [[nodiscard]] std::string_view program() const
+    {
+        if (m_arguments.empty())
+        {
+            return {};
+        }
+        auto program = m_arguments.front();
+        auto slash = program.rfind('/');
+        return slash == std::string_view::npos ? program
+                                               : program.substr(slash + 1);
     }
 
 private:
-    std::string m_name;
-    std::string m_description;
-    std::string m_version;
+    std::string m_buffer;
+    std::vector<std::string_view> m_arguments;
 
-    uint32_t m_curr_arg = 1;
-    std::vector<std::string> m_argv;
+    void split()
+    {
+        m_arguments.clear();
+        std::string_view rest = m_buffer;
+        while (!rest.empty())
+        {
+            auto end = std::min(rest.find('\0'), rest.size());
+            m_arguments.push_back(rest.substr(0, end));
+            rest.remove_prefix(std::min(end + 1, rest.size()));
+        }
+    }
+};
 
-    std::unordered_map<std::string, size_t> m_options_map;
-    std::vector<std::unique_ptr<Option>> m_options;
-    std::vector<size_t> m_option_order;
+/**
+ * @brief Validates the command line of every running process of the given
+ * program against the options of schema with ArgumentParser::validate().
+ * function(pid, command_line, valid) is called for each process while the
+ * schema holds its values, options the process does not specify hold their
+ * default value. An empty program matches all processes. Returns
+ * the number of matching processes.
+ *
+ * @param schema Parser with the options of the program.
+ * @param program File name of the program, without the directory.
+ * @param function Called with (int, const ProcessCommandLine&, bool).
+ */
+template <typename Function>
+size_t scanProcesses(ArgumentParser& schema, std::string_view program,
+                     Function&& function)
+{
+    size_t matches = 0;
+#ifdef CLAPP_HAS_MMAP
+    DIR* proc = ::opendir("/proc");
+    if (proc == nullptr)
+    {
+        return 0;
+    }
+
+    ProcessCommandLine command_line;
+    while (auto* entry = ::readdir(proc))
+    {
+        int pid = 0;
+        auto name = std::string_view(entry->d_name);
+        auto [end, ec] =
+            std::from_chars(name.data(), name.data() + name.size(), pid);
+        if (ec != std::errc{} || end != name.data() + name.size() ||
+            !command_line.load(pid) || command_line.arguments().empty() ||
+            (!program.empty() && command_line.program() != program))
+        {
+            continue;
+        }
+
+        ++matches;
+        const auto& arguments = command_line.arguments();
+        bool valid = true;
+        try
+        {
+            schema.validate(arguments.begin() + 1, arguments.end());
+        }
+        catch (const ArgumentParser::ArgumentParserException&)
+        {
+            valid = false;
+        }
+        function(pid, std::as_const(command_line), valid);
+    }
+    ::closedir(proc);
+#else
+    (void)schema;
+    (void)program;
+    (void)function;
+#endif
+    return matches;
+}
 
+/* Fixed capacity argument parser */
+
+/**
+ * @brief Result of StaticArgumentParser::parse(). Converts to true on
+ * success.
+ *
+ */
+struct ParseResult
+{
+    static constexpr size_t NoIndex = static_cast<size_t>(-1);
+
+    ErrorKind error = ErrorKind::None;
+    // index of the option in registration order
+    size_t option = NoIndex;
+    // index of the offending argument in argv
+    size_t argument = NoIndex;
+
+    explicit operator bool() const { return error == ErrorKind::None; }
+};
+
+/**
+ * @brief Argument parser with a compile-time capacity that never allocates.
+ * Options are backed by a fixed array and store their values into
+ * user-provided variables, conversion uses parseValue(), which must be
+ * overloaded for every value type. Names and choices are kept as views and
+ * must outlive the parser, which is the case for string literals and static
+ * arrays. Errors are reported as ParseResult instead of exceptions. Use
+ * std::string_view values to refer to arguments without copying them.
+ *
+ * @tparam MaxOptions Maximum number of options.
+ */
+template <size_t MaxOptions> class StaticArgumentParser
+{
+public:
     /**
-     * @brief Consumes the next argument of the argument list and returns it.
-     * Increments the internal argument pointer.
+     * @brief Option without a value that sets target to true if specified.
+     *
+     */
+    StaticArgumentParser& flag(std::string_view short_option,
+                               std::string_view long_option, bool& target)
+    {
+        if (auto* entry = add(short_option, long_option, target))
+        {
+            entry->flag = true;
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Option with a value that is converted into target.
      *
-     * @return std::string
      */
-    std::string consume()
+    template <typename T>
+    StaticArgumentParser& option(std::string_view short_option,
+                                 std::string_view long_option, T& target,
+                                 bool required = false)
     {
-        ++m_curr_arg;
-        if (m_curr_arg >= m_argv.size())
-            throw std::runtime_error("No more arguments.");
-        return m_argv[m_curr_arg];
+        if (auto* entry = add(short_option, long_option, target))
+        {
+            entry->required = required;
+        }
+        return *this;
     }
 
     /**
-     * @brief Parses options of type <option>=<value>.
-     * Returns the option and a value, if present.
+     * @brief Option with a value that must be one of choices. Other values
+     * are reported as ErrorKind::ValueNotAllowed.
      *
      */
-    static std::tuple<std::string, std::optional<std::string>>
-    parseOptionWithEqualSign(const std::string& arg)
+    template <typename T, size_t N>
+    StaticArgumentParser& option(std::string_view short_option,
+                                 std::string_view long_option, T& target,
+                                 const T (&choices)[N], bool required = false)
     {
-        auto equal_sign_pos = arg.find('=');
-        if (equal_sign_pos != std::string::npos)
+        if (auto* entry = add(short_option, long_option, target))
         {
-            auto option = arg.substr(0, equal_sign_pos);
-            auto value = arg.substr(equal_sign_pos + 1);
-            return {option, {value}};
+            entry->required = required;
+            entry->choices = choices;
+            entry->choice_count = N;
         }
+        return *this;
+    }
 
-        return {arg, {}};
+    /**
+     * @brief Positional option, assigned in registration order.
+     *
+     */
+    template <typename T>
+    StaticArgumentParser& positional(std::string_view name, T& target,
+                                     bool required = false)
+    {
+        if (auto* entry = add({}, name, target))
+        {
+            entry->positional = true;
+            entry->required = required;
+        }
+        return *this;
     }
 
-    void parseArguments()
+    /**
+     * @brief Parses the arguments, argv[0] is the program name.
+     *
+     */
+    ParseResult parse(int argc, const char* const* argv)
     {
-        while (m_curr_arg < m_argv.size())
+        if (m_overflow)
         {
-            auto arg = m_argv[m_curr_arg];
-            auto [optionStr, possibleValue] = parseOptionWithEqualSign(arg);
-            if (possibleValue)
-            {
-                // if we have an option of type <option>=<value> with a value
-                // store the value as if the arguments were <option> <value>
-                m_argv.insert(m_argv.begin() + m_curr_arg + 1,
-                              possibleValue.value());
-            }
+            return {ErrorKind::CapacityExceeded, MaxOptions, 0};
+        }
 
-            if (m_options_map.find(optionStr) != m_options_map.end())
-            {
-                // we have a proper option
-                auto idx = m_options_map.at(optionStr);
-                auto& option = m_options.at(idx);
+        for (size_t i = 0; i < m_size; ++i)
+        {
+            m_entries[i].set = false;
+        }
+
+        bool end_of_options = false;
+        for (int arg = 1; arg < argc; ++arg)
+        {
+            std::string_view token = argv[arg];
+            auto idx = end_of_options ? ParseResult::NoIndex : find(token);
+            std::string_view value;
+            bool has_value = false;
 
-                if (option->flag)
+            if (!end_of_options && idx == ParseResult::NoIndex)
+            {
+                if (token == "--")
                 {
-                    option->setValue({});
+                    end_of_options = true;
+                    continue;
                 }
-                else
-                {
-                    // get the next argument and use it as value
-                    std::string value = consume();
-
-                    // check if the value is a option, thus the previous
-                    // option with arguments was not satisfied.
-                    if (m_options_map.find(value) != m_options_map.end())
-                    {
-                        std::stringstream ss;
-                        ss << "Expected argument after '" << option->name()
-                           << "', but none given.";
-                        throw ArgumentParserException(ss.str());
-                    }
 
-                    // pass the value to the option
-                    option->setValue(value);
+                auto equal_sign_pos = token.find('=');
+                if (equal_sign_pos != std::string_view::npos)
+                {
+                    idx = find(token.substr(0, equal_sign_pos));
+                    value = token.substr(equal_sign_pos + 1);
+                    has_value = idx != ParseResult::NoIndex;
                 }
 
-                m_option_order.push_back(idx);
-            }
-            else if (!optionStr.empty() && optionStr.at(0) == '-')
-            {
-                std::ostringstream oss;
-                oss << "Unknown option '" << optionStr << "'.";
-                throw ArgumentParserException(oss.str());
+                if (idx == ParseResult::NoIndex && !token.empty() &&
+                    token.front() == '-')
+                {
+                    return {ErrorKind::UnknownOption, ParseResult::NoIndex,
+                            static_cast<size_t>(arg)};
+                }
             }
-            else
+
+            if (idx == ParseResult::NoIndex)
             {
-                // we have no proper option - possibly a positional option
-                for (auto& option : m_options)
+                // possibly a positional option
+                for (size_t i = 0; i < m_size; ++i)
                 {
-                    if (option->isPositionalOption() && !option->set)
+                    if (m_entries[i].positional && !m_entries[i].set)
                     {
-                        option->setValue(optionStr);
-                        m_option_order.push_back(
-                            m_options_map.at(option->long_option));
+                        idx = i;
+                        value = token;
+                        has_value = true;
                         break;
                     }
                 }
+                if (idx == ParseResult::NoIndex)
+                {
+                    continue;
+                }
+            }
+
+            auto& entry = m_entries[idx];
+            if (!has_value && !entry.flag)
+            {
+                if (arg + 1 >= argc ||
+                    find(argv[arg + 1]) != ParseResult::NoIndex)
+                {
+                    return {ErrorKind::MissingValue, idx,
+                            static_cast<size_t>(arg)};
+                }
+                value = argv[++arg];
             }
 
-            ++m_curr_arg;
+            auto error = entry.assign(value, entry);
+            if (error != ErrorKind::None)
+            {
+                return {error, idx, static_cast<size_t>(arg)};
+            }
+            entry.set = true;
         }
 
-        for (auto& option : m_options)
+        for (size_t i = 0; i < m_size; ++i)
         {
-            if (option->has_default_value && !option->set)
+            if (m_entries[i].required && !m_entries[i].set)
             {
-                option->set = true;
+                return {ErrorKind::RequiredOption, i, ParseResult::NoIndex};
             }
         }
+        return {};
     }
 
-    void checkRequiredOptions()
+    /**
+     * @brief Whether the option was specified in the last parse() call.
+     *
+     */
+    [[nodiscard]] bool isSet(size_t option) const
     {
-        for (const auto& option : m_options)
+        return option < m_size && m_entries[option].set;
+    }
+
+    /**
+     * @brief Long name of the option or short name if there is none.
+     *
+     */
+    [[nodiscard]] std::string_view name(size_t option) const
+    {
+        if (option >= m_size)
         {
-            if (option->required && !option->set)
-            {
-                std::stringstream ss;
-                ss << "Option '" << option->name() << "' is required.";
-                throw ArgumentParserException(ss.str());
-            }
+            return {};
         }
+        return m_entries[option].long_option.empty()
+                   ? m_entries[option].short_option
+                   : m_entries[option].long_option;
     }
 
-    void invokeCallbacks()
+    [[nodiscard]] size_t size() const { return m_size; }
+    [[nodiscard]] static constexpr size_t capacity() { return MaxOptions; }
+
+private:
+    struct Entry
+    {
+        std::string_view short_option;
+        std::string_view long_option;
+        void* target = nullptr;
+        // array of choice_count values of the type of target or null
+        const void* choices = nullptr;
+        size_t choice_count = 0;
+        ErrorKind (*assign)(std::string_view, const Entry&) = nullptr;
+        bool flag = false;
+        bool required = false;
+        bool positional = false;
+        bool set = false;
+    };
+
+    Entry m_entries[MaxOptions == 0 ? 1 : MaxOptions];
+    size_t m_size = 0;
+    bool m_overflow = false;
+
+    template <typename T>
+    Entry* add(std::string_view short_option, std::string_view long_option,
+               T& target)
     {
-        for (const auto& option_idx : m_option_order)
+        static_assert(detail::HasParseValue<T>::value,
+                      "StaticArgumentParser requires a parseValue() overload "
+                      "for the value type.");
+        if (m_size >= MaxOptions)
         {
-            auto& option = m_options[option_idx];
-            option->invokeCallback();
+            m_overflow = true;
+            return nullptr;
         }
+
+        auto& entry = m_entries[m_size++];
+        entry = Entry{};
+        entry.short_option = short_option;
+        entry.long_option = long_option;
+        entry.target = &target;
+        entry.assign = [](std::string_view text, const Entry& self)
+        {
+            auto& value = *static_cast<T*>(self.target);
+            if (self.choices == nullptr)
+            {
+                return parseValue(text, value) == std::errc{}
+                           ? ErrorKind::None
+                           : ErrorKind::InvalidValue;
+            }
+
+            // keep the target unchanged if the value is not allowed
+            T parsed{};
+            if (parseValue(text, parsed) != std::errc{})
+            {
+                return ErrorKind::InvalidValue;
+            }
+            const auto* choices = static_cast<const T*>(self.choices);
+            if (std::find(choices, choices + self.choice_count, parsed) ==
+                choices + self.choice_count)
+            {
+                return ErrorKind::ValueNotAllowed;
+            }
+            value = std::move(parsed);
+            return ErrorKind::None;
+        };
+        return &entry;
     }
 
-    bool checkOverrulingOptions()
+    size_t find(std::string_view name) const
     {
-        for (const auto& option : m_options)
+        if (name.empty())
+        {
+            return ParseResult::NoIndex;
+        }
+
+        for (size_t i = 0; i < m_size; ++i)
         {
-            if (option->set && option->overruling)
+            const auto& entry = m_entries[i];
+            if (!entry.positional &&
+                (entry.short_option == name || entry.long_option == name))
             {
-                option->invokeCallback();
-                return true;
+                return i;
             }
         }
-
-        return false;
+        return ParseResult::NoIndex;
     }
 };
+
 } // namespace clapp
@@ -0,0 +1,83 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace alloc_counter
+{
+
+/**
+ * @brief Global counters of the replaced operator new. Only allocations made
+ * while a Scope is active are counted.
+ *
+ */
+struct Counters
+{
+    std::atomic<bool> active{false};
+    std::atomic<size_t> allocations{0};
+    std::atomic<size_t> bytes{0};
+};
+
+inline Counters& counters()
+{
+    static Counters instance;
+    return instance;
+}
+
+/**
+ * @brief Counts the allocations made during its lifetime. Scopes must not be
+ * nested.
+ *
+ */
+class Scope
+{
+public:
+    Scope()
+    {
+        counters().allocations = 0;
+        counters().bytes = 0;
+        counters().active = true;
+    }
+
+    ~Scope() { counters().active = false; }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    [[nodiscard]] size_t allocations() const
+    {
+        return counters().allocations;
+    }
+
+    [[nodiscard]] size_t bytes() const { return counters().bytes; }
+};
+
+inline void* allocate(size_t size)
+{
+    if (counters().active)
+    {
+        ++counters().allocations;
+        counters().bytes += size;
+    }
+
+    void* ptr = std::malloc(size != 0 ? size : 1);
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+} // namespace alloc_counter
+
+// Define ALLOC_COUNTER_IMPLEMENTATION in exactly one translation unit to
+// replace the global allocation functions.
+#ifdef ALLOC_COUNTER_IMPLEMENTATION
+void* operator new(size_t size) { return alloc_counter::allocate(size); }
+void* operator new[](size_t size) { return alloc_counter::allocate(size); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+#endif
@@ -0,0 +1,22 @@
+#include <clapp.hpp>
+
+// Options documented at build time by clapp_generate_docs() in
+// CMakeLists.txt, test_docs.cpp compares them with the runtime rendering.
+void clappDefineOptions(clapp::ArgumentParser& parser)
+{
+    parser.name("clapptest")
+        .version("1.0")
+        .description("Tests the generated documentation.");
+    parser.addHelp();
+    parser.option<int>("-c", "--count")
+        .argument("N")
+        .required()
+        .description("Number of runs.");
+    parser.option<std::string>("--level")
+        .choices({"debug", "info"})
+        .description("Log level, e.g. \"info\".");
+    parser.option<std::string>("--cache")
+        .defaultValue([] { return std::string("/tmp"); }, "system temp")
+        .description("Cache directory.");
+    parser.option<std::string>("FILE").argument("FILE");
+}
@@ -0,0 +1,266 @@
+#define ALLOC_COUNTER_IMPLEMENTATION
+#include "alloc_counter.hpp"
+
+#include "extern/catch2/catch.hpp"
+
+#include <clapp.hpp>
+
+// Allocation budgets of the hot paths. The numbers document the current
+// behaviour, a failing test means a change allocates more than before.
+
+namespace
+{
+std::vector<std::string> optionNames(size_t count)
+{
+    std::vector<std::string> names;
+    for (size_t i = 0; i < count; ++i)
+    {
+        names.push_back("--o" + std::to_string(i));
+    }
+    return names;
+}
+} // namespace
+
+TEST_CASE("test_alloc_registration")
+{
+    auto names = optionNames(1000);
+    clapp::ArgumentParser parser;
+
+    size_t allocations = 0;
+    {
+        alloc_counter::Scope scope;
+        for (const auto& name : names)
+        {
+            parser.option<int>(std::string_view(name));
+        }
+        allocations = scope.allocations();
+    }
+
+    // one node per option plus amortized growth of the tables
+    REQUIRE(allocations <= names.size() + 64);
+}
+
+TEST_CASE("test_alloc_bulk_registration")
+{
+    auto names = optionNames(1000);
+    clapp::ArgumentParser parser;
+
+    size_t text_bytes = 0;
+    for (const auto& name : names)
+    {
+        text_bytes += name.size() + 1;
+    }
+
+    size_t allocations = 0;
+    {
+        alloc_counter::Scope scope;
+        parser.reserve(names.size(), 0, text_bytes)
+            .registerOptions(
+                [&](clapp::ArgumentParser& p)
+                {
+                    for (const auto& name : names)
+                    {
+                        p.option<int>(std::string_view(name));
+                    }
+                });
+        allocations = scope.allocations();
+    }
+
+    REQUIRE(allocations <= names.size() + 16);
+}
+
+TEST_CASE("test_alloc_parse")
+{
+    std::vector<std::string> arguments{"", "-a", "1", "--name=x", "-f",
+                                       "file.txt"};
+    clapp::ArgumentParser parser(arguments);
+    parser.option<int>("-a");
+    parser.option<std::string>("--name");
+    parser.option("-f").flag();
+    parser.option<std::string>("FILE");
+
+    size_t allocations = 0;
+    {
+        alloc_counter::Scope scope;
+        parser.parse();
+        allocations = scope.allocations();
+    }
+
+    // bitsets and the option order, values fit into the small string buffer
+    REQUIRE(allocations <= 10);
+}
+
+TEST_CASE("test_alloc_events_and_feed")
+{
+    std::vector<std::string_view> arguments{"-a", "1", "--name=x", "-f",
+                                            "file.txt"};
+    clapp::ArgumentParser parser;
+    parser.option<int>("-a");
+    parser.option<std::string>("--name");
+    parser.option("-f").flag();
+    parser.option<std::string>("FILE");
+    // warm up the tables
+    for (auto argument : arguments)
+    {
+        parser.feed(argument);
+    }
+    parser.finish();
+
+    size_t event_allocations = 0;
+    size_t events = 0;
+    {
+        alloc_counter::Scope scope;
+        for (const auto& event : parser.events(arguments.begin(),
+                                               arguments.end()))
+        {
+            events += event.argument;
+        }
+        event_allocations = scope.allocations();
+    }
+
+    size_t feed_allocations = 0;
+    {
+        alloc_counter::Scope scope;
+        for (auto argument : arguments)
+        {
+            parser.feed(argument);
+        }
+        feed_allocations = scope.allocations();
+    }
+    parser.finish();
+
+    REQUIRE(events > 0);
+    REQUIRE(event_allocations == 0);
+    REQUIRE(feed_allocations == 0);
+}
+
+TEST_CASE("test_alloc_errors")
+{
+    std::vector<std::string_view> valid{"-a", "1"};
+    std::vector<std::string_view> invalid_value{"-a", "x"};
+    std::vector<std::string_view> unknown_option{"--unknown"};
+    // names and values longer than the small string buffer
+    std::vector<std::string_view> long_value{
+        "--a-rather-long-option-name", "not-a-number-and-longer-than-sso"};
+    clapp::ArgumentParser schema;
+    schema.option<int>("-a");
+    schema.option<int>("--a-rather-long-option-name");
+    // warm up the tables
+    schema.validate(valid.begin(), valid.end());
+
+    size_t allocations = 0;
+    size_t failures = 0;
+    {
+        alloc_counter::Scope scope;
+        for (size_t i = 0; i < 100; ++i)
+        {
+            const auto& arguments = i % 3 == 0   ? invalid_value
+                                    : i % 3 == 1 ? unknown_option
+                                                 : long_value;
+            try
+            {
+                schema.validate(arguments.begin(), arguments.end());
+            }
+            catch (const clapp::ArgumentParser::ArgumentParserException&)
+            {
+                ++failures;
+            }
+        }
+        allocations = scope.allocations();
+    }
+
+    // one allocation per failure for the record and its parts, the messages
+    // are never formatted
+    REQUIRE(failures == 100);
+    REQUIRE(allocations <= failures);
+}
+
+TEST_CASE("test_alloc_command_line_splitter")
+{
+    size_t allocations = 0;
+    size_t arguments = 0;
+    {
+        alloc_counter::Scope scope;
+        clapp::CommandLineSplitter splitter("tool -a 1 --name x file.txt");
+        std::string_view argument;
+        while (splitter.next(argument))
+        {
+            ++arguments;
+        }
+        allocations = scope.allocations();
+    }
+
+    REQUIRE(arguments == 6);
+    REQUIRE(allocations == 0);
+}
+
+TEST_CASE("test_alloc_callbacks")
+{
+    std::vector<std::string> arguments{"", "-a", "1", "-f"};
+    clapp::ArgumentParser parser(arguments);
+
+    int sum = 0;
+    parser.option<int>("-a").callback([&](int value) { sum += value; });
+    parser.option("-f").flag().callback([&](bool value) { sum += value; });
+    parser.parse();
+
+    size_t allocations = 0;
+    {
+        alloc_counter::Scope scope;
+        parser.feed("-a");
+        parser.feed("2");
+        parser.feed("-f");
+        parser.finish();
+        allocations = scope.allocations();
+    }
+
+    REQUIRE(sum == 5);
+    REQUIRE(allocations == 0);
+}
+
+TEST_CASE("test_alloc_help")
+{
+    std::vector<std::string> arguments{"tool"};
+    clapp::ArgumentParser parser(arguments);
+    parser.name("tool").version("1.0").description("Test tool.").addHelp();
+    parser.option<int>("-a", "--alpha").description("Alpha value.");
+    parser.option<std::string>("--level").choices({"debug", "info"});
+    parser.option("-f").flag().description("Some flag.");
+
+    size_t allocations = 0;
+    {
+        alloc_counter::Scope scope;
+        auto help = parser.help();
+        allocations = scope.allocations();
+    }
+
+    REQUIRE(allocations <= 100);
+}
+
+TEST_CASE("test_alloc_static_parser")
+{
+    const char* argv[] = {"tool", "-v", "--count=3", "--name", "abc",
+                          "input.txt"};
+
+    size_t allocations = 0;
+    bool parsed = false;
+    {
+        alloc_counter::Scope scope;
+        bool verbose = false;
+        int count = 0;
+        double ratio = 0;
+        std::string_view name;
+        std::string_view input;
+        clapp::StaticArgumentParser<8> parser;
+        parser.flag("-v", "--verbose", verbose)
+            .option("-c", "--count", count)
+            .option("-r", "--ratio", ratio)
+            .option("-n", "--name", name)
+            .positional("INPUT", input);
+        parsed = static_cast<bool>(parser.parse(6, argv));
+        allocations = scope.allocations();
+    }
+
+    REQUIRE(parsed);
+    REQUIRE(allocations == 0);
+}
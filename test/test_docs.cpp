@@ -0,0 +1,71 @@
+#include "extern/catch2/catch.hpp"
+
+#include <clapp.hpp>
+
+#include <clapptest_help.hpp>
+
+void clappDefineOptions(clapp::ArgumentParser& parser);
+
+TEST_CASE("test_prerendered_help")
+{
+    clapp::ArgumentParser parser(std::vector<std::string>{"clapptest"});
+    clappDefineOptions(parser);
+
+    REQUIRE(clapp_docs::fingerprint == parser.helpFingerprint());
+    REQUIRE(clapp_docs::help == parser.help());
+
+    parser.prerenderedHelp(clapp_docs::help, clapp_docs::fingerprint);
+    auto print = [&parser]
+    {
+        std::ostringstream captured;
+        auto* previous = std::cout.rdbuf(captured.rdbuf());
+        parser.printHelp();
+        std::cout.rdbuf(previous);
+        return captured.str();
+    };
+    REQUIRE(print() == parser.help());
+
+    // any change of the rendered help discards the prerendered text
+    parser.description("Changed description.");
+    REQUIRE(clapp_docs::fingerprint != parser.helpFingerprint());
+    REQUIRE(print() == parser.help());
+    REQUIRE(print().find("Changed description.") != std::string::npos);
+}
+
+TEST_CASE("test_prerendered_help_installed_path")
+{
+    // argv[0] at runtime includes the directory of the executable
+    clapp::ArgumentParser parser(
+        std::vector<std::string>{"/usr/local/bin/clapptest"});
+    clappDefineOptions(parser);
+
+    REQUIRE(clapp_docs::fingerprint == parser.helpFingerprint());
+    REQUIRE(clapp_docs::help == parser.help());
+
+    parser.prerenderedHelp("prerendered\n", clapp_docs::fingerprint);
+    std::ostringstream captured;
+    auto* previous = std::cout.rdbuf(captured.rdbuf());
+    parser.printHelp();
+    std::cout.rdbuf(previous);
+    REQUIRE(captured.str() == "prerendered\n");
+}
+
+TEST_CASE("test_man_page_and_markdown")
+{
+    clapp::ArgumentParser parser(std::vector<std::string>{"clapptest"});
+    clappDefineOptions(parser);
+
+    auto man = parser.manPage(1);
+    REQUIRE(man.rfind(".TH \"CLAPPTEST\" \"1\" \"\" \"clapptest 1.0\"\n", 0) ==
+            0);
+    REQUIRE(man.find(".SH OPTIONS\n") != std::string::npos);
+    REQUIRE(man.find("\\fB\\-c, \\-\\-count\\fR \\fI<N>\\fR\n"
+                     "Number of runs. Required.\n") != std::string::npos);
+
+    auto markdown = parser.markdown();
+    REQUIRE(markdown.rfind("# clapptest 1.0\n", 0) == 0);
+    REQUIRE(markdown.find("- `--level`: Log level, e.g. \"info\". One of: "
+                          "debug info.\n") != std::string::npos);
+    REQUIRE(markdown.find("- `--cache`: Cache directory. Default: system "
+                          "temp.\n") != std::string::npos);
+}
@@ -3,6 +3,58 @@
 
 #include <clapp.hpp>
 
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+
+struct MoveOnlyValue
+{
+    MoveOnlyValue() = default;
+    explicit MoveOnlyValue(const std::string& value)
+        : data{std::make_unique<std::string>(value)}
+    {
+    }
+    MoveOnlyValue(MoveOnlyValue&&) = default;
+    MoveOnlyValue& operator=(MoveOnlyValue&&) = default;
+
+    std::unique_ptr<std::string> data;
+};
+
+// takes precedence over the builtin parseValue() for long
+template <> struct clapp::TypeParser<long>
+{
+    static long Get(const std::string& value)
+    {
+        return std::stol(value, nullptr, 0);
+    }
+};
+
+namespace units
+{
+struct Size
+{
+    unsigned long long bytes = 0;
+
+    bool operator<(const Size& other) const { return bytes < other.bytes; }
+};
+
+inline std::errc parseValue(std::string_view text, Size& size)
+{
+    unsigned long long factor = 1;
+    if (!text.empty() && (text.back() == 'k' || text.back() == 'M'))
+    {
+        factor = text.back() == 'k' ? 1024 : 1024 * 1024;
+        text.remove_suffix(1);
+    }
+    if (clapp::parseValue(text, size.bytes) != std::errc{})
+    {
+        return std::errc::invalid_argument;
+    }
+    size.bytes *= factor;
+    return {};
+}
+} // namespace units
+
 TEST_CASE("test_int_store")
 {
     std::vector<std::string> arguments{"", "-a", "123", "-b", "hello"};
@@ -245,3 +297,1166 @@ TEST_CASE("test_option_multiple_positional_required_empty")
 
     REQUIRE_FALSE(parser.parse());
 }
+
+TEST_CASE("test_config_file")
+{
+    const char* path = "clapp_test_config.ini";
+    {
+        std::ofstream file(path);
+        file << "# comment\n"
+             << "count = 42\n"
+             << "name = \"from file\"\n"
+             << "verbose\n"
+             << "[log]\n"
+             << "level = debug\n";
+    }
+
+    std::vector<std::string> arguments{"", "--name", "from argv"};
+    clapp::ArgumentParser parser(arguments);
+
+    auto& count = parser.option<int>("--count");
+    auto& name = parser.option<std::string>("--name");
+    auto& verbose = parser.option("-v", "--verbose").flag();
+    auto& level = parser.option<std::string>("--log.level")
+                      .choices({"debug", "info"});
+    parser.configFile(path);
+    std::remove(path);
+    parser.parse();
+
+    REQUIRE(count.value() == 42);
+    REQUIRE(name.value() == "from argv");
+    REQUIRE(verbose.value());
+    REQUIRE(level.value() == "debug");
+}
+
+TEST_CASE("test_config_file_environment_precedence")
+{
+    const char* path = "clapp_test_config_env.ini";
+    {
+        std::ofstream file(path);
+        file << "threads = 2\n";
+    }
+
+    std::vector<std::string> arguments{""};
+    clapp::ArgumentParser parser(arguments);
+
+    auto& threads =
+        parser.option<int>("--threads").env("CLAPP_TEST_THREADS").required();
+    parser.configFile(path);
+    std::remove(path);
+
+    setenv("CLAPP_TEST_THREADS", "8", 1);
+    REQUIRE(parser.parse());
+    unsetenv("CLAPP_TEST_THREADS");
+
+    REQUIRE(threads.value() == 8);
+}
+
+TEST_CASE("test_config_file_unknown_key")
+{
+    const char* path = "clapp_test_config_unknown.ini";
+    {
+        std::ofstream file(path);
+        file << "unknown = 1\n";
+    }
+
+    std::vector<std::string> arguments{"", "-a"};
+    clapp::ArgumentParser parser(arguments);
+    parser.option("-a").flag();
+
+    REQUIRE_THROWS_AS(parser.configFile(path),
+                      clapp::ArgumentParser::ArgumentParserException);
+    std::remove(path);
+}
+
+TEST_CASE("test_snapshot_restore")
+{
+    std::string blob;
+    {
+        std::vector<std::string> arguments{"", "-a", "123", "--name",
+                                           "hello", "-f"};
+        clapp::ArgumentParser parser(arguments);
+        parser.option<int>("-a");
+        parser.option<std::string>("--name");
+        parser.option<double>("-d").defaultValue(2.5);
+        parser.option("-f").flag();
+        REQUIRE(parser.parse());
+        blob = parser.snapshot();
+    }
+
+    std::vector<std::string> arguments{""};
+    clapp::ArgumentParser parser(arguments);
+    int a = 0;
+    std::string name;
+    int callbacks = 0;
+    parser.option<int>("-a").store(a).callback([&](int) { ++callbacks; });
+    parser.option<std::string>("--name").store(name);
+    auto& d = parser.option<double>("-d").defaultValue(2.5);
+    auto& f = parser.option("-f").flag();
+
+    REQUIRE(parser.restore(blob));
+    REQUIRE(a == 123);
+    REQUIRE(name == "hello");
+    REQUIRE(d.value() == 2.5);
+    REQUIRE(f.value());
+    REQUIRE(callbacks == 1);
+    REQUIRE(parser.snapshot() == blob);
+}
+
+TEST_CASE("test_snapshot_replaces_live_values")
+{
+    clapp::ArgumentParser parser;
+    auto& a = parser.option<int>("-a").defaultValue(1);
+    parser.option("-f").flag();
+
+    REQUIRE(parser.parse("tool -f"));
+    auto blob = parser.snapshot();
+
+    REQUIRE(parser.parse("tool -a 9"));
+    REQUIRE(a.value() == 9);
+    REQUIRE(parser.restore(blob));
+    REQUIRE_FALSE(parser.specified("-a"));
+    REQUIRE(a.value() == 1);
+}
+
+TEST_CASE("test_snapshot_schema_mismatch")
+{
+    std::string blob;
+    {
+        std::vector<std::string> arguments{"", "-a", "123"};
+        clapp::ArgumentParser parser(arguments);
+        parser.option<int>("-a");
+        REQUIRE(parser.parse());
+        blob = parser.snapshot();
+    }
+
+    std::vector<std::string> arguments{"", "-a", "7"};
+    clapp::ArgumentParser parser(arguments);
+    auto& a = parser.option<std::string>("-a");
+
+    REQUIRE_FALSE(parser.restore(blob));
+    REQUIRE_FALSE(parser.restore(blob.substr(0, blob.size() - 1)));
+    REQUIRE(parser.parse());
+    REQUIRE(a.value() == "7");
+}
+
+TEST_CASE("test_snapshot_tightened_range")
+{
+    std::string blob;
+    {
+        clapp::ArgumentParser parser;
+        parser.option<int>("-a").range(1, 200);
+        REQUIRE(parser.parse("tool -a 150"));
+        blob = parser.snapshot();
+    }
+
+    clapp::ArgumentParser parser;
+    parser.option<int>("-a").range(1, 100);
+    REQUIRE_FALSE(parser.restore(blob));
+
+    clapp::ArgumentParser validated;
+    validated.option<int>("-a").range(1, 200).validate(
+        [](int value) { return value % 2 == 0; }, "is odd");
+    REQUIRE_FALSE(validated.restore(blob));
+}
+
+TEST_CASE("test_snapshot_after_failed_parse")
+{
+    struct Label
+    {
+        const char* text;
+    };
+    static_assert(clapp::ValueCodec<int>::supported);
+    static_assert(!clapp::ValueCodec<Label>::supported);
+
+    clapp::ArgumentParser parser;
+    parser.option<int>("-a");
+
+    REQUIRE(parser.parse("tool -a 1"));
+    REQUIRE_NOTHROW(parser.snapshot());
+    REQUIRE_THROWS(parser.parse("tool -a x"));
+    REQUIRE_THROWS_AS(parser.snapshot(),
+                      clapp::ArgumentParser::ArgumentParserException);
+}
+
+TEST_CASE("test_required_with_default_value")
+{
+    std::vector<std::string> arguments{"", "-b"};
+    clapp::ArgumentParser parser(arguments);
+
+    auto& a = parser.option<int>("-a").required().defaultValue(3);
+    parser.option("-b").flag();
+
+    REQUIRE(parser.parse());
+    REQUIRE(a.value() == 3);
+}
+
+TEST_CASE("test_constraint_mutually_exclusive")
+{
+    std::vector<std::string> arguments{"", "--json", "--xml"};
+    clapp::ArgumentParser parser(arguments);
+
+    parser.option("--json").flag();
+    parser.option("--xml").flag();
+    parser.option("--text").flag();
+    parser.mutuallyExclusive({"--json", "--xml", "--text"});
+
+    REQUIRE_THROWS_AS(parser.parse(),
+                      clapp::ArgumentParser::ArgumentParserException);
+}
+
+TEST_CASE("test_constraint_at_least_one_of")
+{
+    std::vector<std::string> arguments{"", "-v"};
+    clapp::ArgumentParser parser(arguments);
+
+    parser.option("-v").flag();
+    parser.option<std::string>("--input");
+    parser.option<std::string>("--url");
+    parser.atLeastOneOf({"--input", "--url"});
+
+    REQUIRE_THROWS_AS(parser.parse(),
+                      clapp::ArgumentParser::ArgumentParserException);
+}
+
+TEST_CASE("test_constraint_requires_all_of")
+{
+    std::vector<std::string> arguments{"", "--user", "me", "--password",
+                                       "secret"};
+    clapp::ArgumentParser parser(arguments);
+
+    parser.option<std::string>("--user");
+    parser.option<std::string>("--password");
+    parser.option<std::string>("--host");
+    parser.requiresAllOf("--user", {"--password"});
+    REQUIRE(parser.parse());
+
+    std::vector<std::string> missing_arguments{"", "--user", "me"};
+    clapp::ArgumentParser missing_parser(missing_arguments);
+    missing_parser.option<std::string>("--user");
+    missing_parser.option<std::string>("--password");
+    missing_parser.requiresAllOf("--user", {"--password"});
+    REQUIRE_THROWS_AS(missing_parser.parse(),
+                      clapp::ArgumentParser::ArgumentParserException);
+    REQUIRE_THROWS_AS(missing_parser.requiresAllOf("--user", {"--unknown"}),
+                      clapp::ArgumentParser::ArgumentParserException);
+}
+
+TEST_CASE("test_overruling_skips_remaining_arguments")
+{
+    std::vector<std::string> arguments{"", "-a", "1", "--info",
+                                       "--unknown", "-a", "not a number"};
+    clapp::ArgumentParser parser(arguments);
+
+    int invoked = 0;
+    parser.option<int>("-a");
+    parser.option<std::string>("FILE").required();
+    parser.option("--info").flag().overruling().callback(
+        [&](bool) { ++invoked; });
+
+    REQUIRE_FALSE(parser.parse());
+    REQUIRE(invoked == 1);
+}
+
+TEST_CASE("test_feed_tokens")
+{
+    clapp::ArgumentParser parser;
+
+    auto& a = parser.option<int>("-a");
+    auto& name = parser.option<std::string>("--name");
+    auto& file = parser.option<std::string>("FILE").required();
+    auto& flag = parser.option("-f").flag();
+
+    parser.feed("-a");
+    parser.feed("5");
+    parser.feed("--name=abc");
+    parser.feed("file.txt");
+    parser.feed("-f");
+    REQUIRE(parser.finish());
+
+    REQUIRE(a.value() == 5);
+    REQUIRE(name.value() == "abc");
+    REQUIRE(file.value() == "file.txt");
+    REQUIRE(flag.value());
+}
+
+TEST_CASE("test_feed_reports_errors_immediately")
+{
+    clapp::ArgumentParser parser;
+
+    parser.option<std::string>("--level").choices({"debug", "info"});
+    parser.option<int>("-a");
+
+    REQUIRE_THROWS_AS(parser.feed("--level=trace"),
+                      clapp::ArgumentParser::ArgumentParserException);
+    REQUIRE_THROWS_AS(parser.feed("--unknown"),
+                      clapp::ArgumentParser::ArgumentParserException);
+
+    parser.feed("-a");
+    REQUIRE_THROWS_AS(parser.finish(),
+                      clapp::ArgumentParser::ArgumentParserException);
+}
+
+TEST_CASE("test_reuse_parser")
+{
+    clapp::ArgumentParser parser;
+    auto& a = parser.option<int>("-a").defaultValue(1);
+    auto& b = parser.option<int>("-b");
+    parser.option("-f").flag();
+
+    parser.feed("-a");
+    parser.feed("5");
+    REQUIRE(parser.finish());
+    REQUIRE(a.value() == 5);
+
+    // a successful run does not leak into the next one
+    parser.feed("-f");
+    REQUIRE(parser.finish());
+    REQUIRE(a.value() == 1);
+    REQUIRE_FALSE(parser.specified("-a"));
+
+    // neither do the values a failed run stored before the error
+    parser.feed("-a");
+    parser.feed("7");
+    REQUIRE_THROWS_AS(parser.feed("-b=x"),
+                      clapp::ArgumentParser::ArgumentParserException);
+    REQUIRE(a.value() == 7);
+    parser.feed("-b");
+    parser.feed("2");
+    REQUIRE(parser.finish());
+    REQUIRE(a.value() == 1);
+    REQUIRE(b.value() == 2);
+}
+
+TEST_CASE("test_event_stream")
+{
+    std::vector<std::string> arguments{"",   "-a", "1", "--name=x", "file",
+                                       "-f", "--", "-f"};
+    clapp::ArgumentParser parser(arguments);
+
+    auto& a = parser.option<int>("-a").defaultValue(7);
+    parser.option<std::string>("--name");
+    parser.option("-f").flag();
+
+    using Kind = clapp::ArgumentParser::Event::Kind;
+    std::vector<std::tuple<Kind, std::string_view, size_t>> events;
+    for (const auto& event : parser.events())
+    {
+        events.emplace_back(event.kind, event.value, event.argument);
+    }
+
+    REQUIRE(events.size() == 6);
+    REQUIRE(events[0] == std::make_tuple(Kind::Option, "1", size_t{0}));
+    REQUIRE(events[1] == std::make_tuple(Kind::Option, "x", size_t{2}));
+    REQUIRE(events[2] == std::make_tuple(Kind::Positional, "file", size_t{3}));
+    REQUIRE(events[3] == std::make_tuple(Kind::Option, "", size_t{4}));
+    REQUIRE(events[4] == std::make_tuple(Kind::EndOfOptions, "", size_t{5}));
+    REQUIRE(events[5] == std::make_tuple(Kind::Positional, "-f", size_t{6}));
+    REQUIRE(a.value() == 7);
+}
+
+TEST_CASE("test_end_of_options")
+{
+    std::vector<std::string> arguments{"", "-v", "--", "-file-"};
+    clapp::ArgumentParser parser(arguments);
+
+    auto& verbose = parser.option("-v").flag();
+    auto& file = parser.option<std::string>("FILE");
+    parser.parse();
+
+    REQUIRE(verbose.value());
+    REQUIRE(file.value() == "-file-");
+}
+
+TEST_CASE("test_command_line_splitter")
+{
+    clapp::CommandLineSplitter splitter(
+        R"(  tool -a 'single quoted' "double \"quoted\"" esc\ aped "a"'b'c )");
+
+    std::vector<std::string> arguments;
+    std::string_view argument;
+    while (splitter.next(argument))
+    {
+        arguments.emplace_back(argument);
+    }
+
+    REQUIRE_FALSE(splitter.unterminated());
+    REQUIRE(arguments == std::vector<std::string>{"tool", "-a",
+                                                  "single quoted",
+                                                  "double \"quoted\"",
+                                                  "esc aped", "abc"});
+
+    clapp::CommandLineSplitter unterminated("tool 'open");
+    while (unterminated.next(argument))
+    {
+    }
+    REQUIRE(unterminated.unterminated());
+}
+
+TEST_CASE("test_parse_command_line")
+{
+    clapp::ArgumentParser parser;
+
+    auto& name = parser.option<std::string>("--name");
+    auto& count = parser.option<int>("-n");
+    auto& file = parser.option<std::string>("FILE");
+
+    REQUIRE(parser.parse(R"(tool --name "John Doe" -n 3 -- '-file')"));
+    REQUIRE(name.value() == "John Doe");
+    REQUIRE(count.value() == 3);
+    REQUIRE(file.value() == "-file");
+}
+
+TEST_CASE("test_packed_value_storage")
+{
+    std::vector<std::string> arguments{"", "-b", "-x", "2", "-d"};
+    clapp::ArgumentParser parser(arguments);
+
+    auto& a = parser.option("-a").flag();
+    auto& b = parser.option("-b").flag();
+    auto& x = parser.option<int>("-x");
+    auto& y = parser.option<int>("-y");
+    auto& c = parser.option("-c").flag();
+    auto& d = parser.option("-d").flag();
+    parser.parse();
+
+    REQUIRE_FALSE(a.value());
+    REQUIRE(b.value());
+    REQUIRE_FALSE(c.value());
+    REQUIRE(d.value());
+    REQUIRE(x.value() == 2);
+    REQUIRE(y.value() == 0);
+
+    c.value() = true;
+    y.value() = 5;
+    REQUIRE(c.value());
+    REQUIRE_FALSE(a.value());
+    REQUIRE(y.value() == 5);
+    REQUIRE(x.value() == 2);
+}
+
+TEST_CASE("test_value_references_stay_valid")
+{
+    clapp::ArgumentParser parser;
+
+    int& x = parser.option<int>("-x").defaultValue(1).value();
+    bool& flag = parser.option("-f").flag().value();
+    for (int i = 0; i < 1000; ++i)
+    {
+        parser.option<int>("--int" + std::to_string(i));
+        parser.option("--flag" + std::to_string(i)).flag();
+    }
+
+    REQUIRE(parser.parse("tool -x 7 -f"));
+    REQUIRE(x == 7);
+    REQUIRE(flag);
+}
+
+TEST_CASE("test_bulk_registration")
+{
+    std::vector<std::string> arguments{"", "--opt42", "42", "-s7"};
+    clapp::ArgumentParser parser(arguments);
+
+    std::vector<std::string> names;
+    for (int i = 0; i < 1000; ++i)
+    {
+        names.push_back("--opt" + std::to_string(i));
+    }
+
+    int value = 0;
+    parser.reserve(names.size() + 1)
+        .registerOptions(
+            [&](clapp::ArgumentParser& p)
+            {
+                for (const auto& name : names)
+                {
+                    p.option<int>(std::string_view(name));
+                }
+                p.option<int>(std::string("--opt42")).store(value);
+                p.option(std::string("-s7"), "--seven").flag();
+            });
+    parser.parse();
+
+    REQUIRE(value == 42);
+}
+
+TEST_CASE("test_store_target_is_storage")
+{
+    std::vector<std::string> arguments{"", "--name", "hello", "-f"};
+    clapp::ArgumentParser parser(arguments);
+
+    std::string name;
+    bool flag = false;
+    auto& name_option =
+        parser.option<std::string>("--name").defaultValue("x").store(name);
+    auto& flag_option = parser.option("-f").flag().store(flag);
+
+    REQUIRE(name == "x");
+    REQUIRE(&name_option.value() == &name);
+
+    parser.parse();
+
+    REQUIRE(name == "hello");
+    REQUIRE(flag);
+    REQUIRE(flag_option.value());
+    name_option.value() = "changed";
+    REQUIRE(name == "changed");
+}
+
+TEST_CASE("test_move_only_value")
+{
+    std::vector<std::string> arguments{"", "--data", "payload"};
+    clapp::ArgumentParser parser(arguments);
+
+    MoveOnlyValue data;
+    std::string seen;
+    parser.option<MoveOnlyValue>("--data")
+        .store(data)
+        .callback([&](const MoveOnlyValue& value) { seen = *value.data; });
+    parser.parse();
+
+    REQUIRE(data.data);
+    REQUIRE(*data.data == "payload");
+    REQUIRE(seen == "payload");
+}
+
+TEST_CASE("test_custom_parse_value")
+{
+    std::vector<std::string> arguments{"", "--size", "4k", "--limit", "1M"};
+    clapp::ArgumentParser parser(arguments);
+
+    auto& size = parser.option<units::Size>("--size");
+    auto& limit = parser.option<units::Size>("--limit")
+                      .choices({units::Size{1024}, units::Size{1048576}});
+    parser.parse();
+
+    REQUIRE(size.value().bytes == 4096);
+    REQUIRE(limit.value().bytes == 1048576);
+
+    std::vector<std::string> invalid_arguments{"", "--size", "4x"};
+    clapp::ArgumentParser invalid_parser(invalid_arguments);
+    invalid_parser.option<units::Size>("--size");
+    REQUIRE_THROWS_AS(invalid_parser.parse(),
+                      clapp::ArgumentParser::ArgumentParserException);
+}
+
+TEST_CASE("test_invalid_number")
+{
+    std::vector<std::string> arguments{"", "-a", "12abc"};
+    clapp::ArgumentParser parser(arguments);
+
+    parser.option<int>("-a");
+
+    REQUIRE_THROWS_AS(parser.parse(),
+                      clapp::ArgumentParser::ArgumentParserException);
+}
+
+TEST_CASE("test_number_signs")
+{
+    int value = 0;
+    REQUIRE(clapp::parseValue("+5", value) == std::errc{});
+    REQUIRE(value == 5);
+    REQUIRE(clapp::parseValue("-5", value) == std::errc{});
+    REQUIRE(value == -5);
+    REQUIRE(clapp::parseValue("+-5", value) == std::errc::invalid_argument);
+    REQUIRE(clapp::parseValue("++5", value) == std::errc::invalid_argument);
+
+    double ratio = 0;
+    REQUIRE(clapp::parseValue("+-0.5", ratio) == std::errc::invalid_argument);
+}
+
+TEST_CASE("test_type_parser_specialization")
+{
+    clapp::ArgumentParser parser;
+    auto& mask = parser.option<long>("--mask");
+
+    REQUIRE(parser.parse("tool --mask 0x10"));
+    REQUIRE(mask.value() == 16);
+}
+
+TEST_CASE("test_static_parser")
+{
+    const char* argv[] = {"tool", "-v", "--count=3", "--name", "abc",
+                          "input.txt"};
+
+    bool verbose = false;
+    int count = 0;
+    std::string_view name;
+    std::string_view input;
+    clapp::StaticArgumentParser<4> parser;
+    parser.flag("-v", "--verbose", verbose)
+        .option("-c", "--count", count, true)
+        .option("", "--name", name)
+        .positional("INPUT", input);
+
+    auto result = parser.parse(6, argv);
+
+    REQUIRE(result);
+    REQUIRE(verbose);
+    REQUIRE(count == 3);
+    REQUIRE(name == "abc");
+    REQUIRE(input == "input.txt");
+    REQUIRE(parser.isSet(1));
+}
+
+TEST_CASE("test_static_parser_errors")
+{
+    int count = 0;
+    bool flag = false;
+    clapp::StaticArgumentParser<2> parser;
+    parser.option("-c", "--count", count, true).flag("-f", "", flag);
+
+    const char* unknown[] = {"tool", "-x"};
+    auto result = parser.parse(2, unknown);
+    REQUIRE(result.error == clapp::ErrorKind::UnknownOption);
+    REQUIRE(result.argument == 1);
+
+    const char* invalid[] = {"tool", "-c", "abc"};
+    result = parser.parse(3, invalid);
+    REQUIRE(result.error == clapp::ErrorKind::InvalidValue);
+    REQUIRE(parser.name(result.option) == "--count");
+
+    const char* missing[] = {"tool", "-f"};
+    result = parser.parse(2, missing);
+    REQUIRE(result.error == clapp::ErrorKind::RequiredOption);
+
+    parser.flag("-g", "", flag);
+    result = parser.parse(2, missing);
+    REQUIRE(result.error == clapp::ErrorKind::CapacityExceeded);
+}
+
+TEST_CASE("test_static_parser_choices")
+{
+    static constexpr std::string_view levels[] = {"debug", "info"};
+    std::string_view level;
+    clapp::StaticArgumentParser<1> parser;
+    parser.option("-l", "--level", level, levels);
+
+    const char* allowed[] = {"tool", "--level=info"};
+    REQUIRE(parser.parse(2, allowed));
+    REQUIRE(level == "info");
+
+    const char* not_allowed[] = {"tool", "-l", "trace"};
+    auto result = parser.parse(3, not_allowed);
+    REQUIRE(result.error == clapp::ErrorKind::ValueNotAllowed);
+    REQUIRE(result.argument == 2);
+    REQUIRE(level == "info");
+}
+
+TEST_CASE("test_validators")
+{
+    std::vector<std::string> arguments{"", "--port", "8080", "--user",
+                                       "admin", "--ratio", "0.5"};
+    clapp::ArgumentParser parser(arguments);
+
+    auto& port = parser.option<int>("--port").range<1, 65535>();
+    auto& user = parser.option<std::string>("--user").pattern("[a-z]+");
+    auto& ratio = parser.option<double>("--ratio")
+                      .range(0.0, 1.0)
+                      .validate([](double value) { return value != 0.0; },
+                                "must not be zero");
+    parser.parse();
+
+    REQUIRE(port.value() == 8080);
+    REQUIRE(user.value() == "admin");
+    REQUIRE(ratio.value() == 0.5);
+}
+
+TEST_CASE("test_validators_fail")
+{
+    auto parse = [](std::vector<std::string> arguments)
+    {
+        clapp::ArgumentParser parser(arguments);
+        parser.option<int>("--port").range<1, 65535>();
+        parser.option<std::string>("--user").pattern("[a-z]+");
+        parser.option<double>("--ratio").validate(
+            [](double value) { return value != 0.0; }, "must not be zero");
+        return parser.parse();
+    };
+
+    REQUIRE_THROWS_AS(parse({"", "--port", "0"}),
+                      clapp::ArgumentParser::ArgumentParserException);
+    REQUIRE_THROWS_AS(parse({"", "--user", "Admin1"}),
+                      clapp::ArgumentParser::ArgumentParserException);
+    REQUIRE_THROWS_WITH(parse({"", "--ratio", "0"}),
+                        Catch::Contains("must not be zero"));
+
+    clapp::ArgumentParser parser;
+    REQUIRE_THROWS_AS(parser.option<int>("-a").range(5, 1),
+                      clapp::ArgumentParser::ArgumentParserException);
+}
+
+TEST_CASE("test_lazy_default_value")
+{
+    std::vector<std::string> arguments{"", "--threads", "4"};
+    clapp::ArgumentParser parser(arguments);
+
+    int generated = 0;
+    int threads = 0;
+    std::string cache;
+    parser.option<int>("--threads")
+        .defaultValue(
+            [&]
+            {
+                ++generated;
+                return 16;
+            },
+            "number of CPUs")
+        .store(threads);
+    auto& cache_option = parser.option<std::string>("--cache")
+                             .required()
+                             .defaultValue(
+                                 [&]
+                                 {
+                                     ++generated;
+                                     return std::string("/tmp/cache");
+                                 })
+                             .store(cache);
+
+    REQUIRE(parser.help().find("(default: number of CPUs)") !=
+            std::string::npos);
+    REQUIRE(generated == 0);
+
+    REQUIRE(parser.parse());
+    REQUIRE(threads == 4);
+    REQUIRE(cache == "/tmp/cache");
+    REQUIRE(cache_option.value() == "/tmp/cache");
+    REQUIRE(generated == 1);
+
+    REQUIRE(parser.parse());
+    REQUIRE(generated == 1);
+}
+
+TEST_CASE("test_lazy_default_bool")
+{
+    std::vector<std::string> arguments{"", "-v"};
+    clapp::ArgumentParser parser(arguments);
+    parser.option("-v").flag();
+
+    // captureless lambdas convert to bool, they must still be generators
+    static int generated = 0;
+    auto& color = parser.option<bool>("--color").defaultValue(
+        []
+        {
+            ++generated;
+            return false;
+        });
+
+    REQUIRE(generated == 0);
+    REQUIRE_FALSE(color.value());
+    REQUIRE(parser.parse());
+    REQUIRE(generated == 1);
+    REQUIRE_FALSE(color.value());
+}
+
+TEST_CASE("test_callback_dependencies")
+{
+    std::vector<std::string> arguments{"", "-c", "-b", "-a"};
+    clapp::ArgumentParser parser(arguments);
+
+    std::string order;
+    for (const char* name : {"-a", "-b", "-c"})
+    {
+        parser.option(name).flag().callback([&order, name](bool)
+                                            { order += name + 1; });
+    }
+    parser.callbackAfter("-c", {"-a", "-b"});
+
+    REQUIRE(parser.parse());
+    REQUIRE(order == "bac");
+
+    parser.callbackAfter("-a", {"-c"});
+    REQUIRE_THROWS_AS(parser.parse(),
+                      clapp::ArgumentParser::ArgumentParserException);
+}
+
+#ifdef CLAPP_ENABLE_THREADS
+TEST_CASE("test_parallel_callbacks")
+{
+    std::vector<std::string> arguments{"", "-a", "-b", "-c", "-d"};
+    clapp::ArgumentParser parser(arguments);
+
+    std::atomic<int> log_ready{0};
+    std::atomic<int> invoked{0};
+    bool dependency_done = false;
+    parser.option("-a").flag().callback(
+        [&](bool)
+        {
+            log_ready = 1;
+            ++invoked;
+        });
+    parser.option("-b").flag().callback(
+        [&](bool)
+        {
+            dependency_done = log_ready == 1;
+            ++invoked;
+        });
+    parser.option("-c").flag().callback(
+        [&](bool)
+        {
+            ++invoked;
+            throw std::runtime_error("c");
+        });
+    parser.option("-d").flag().callback([&](bool) { ++invoked; });
+    parser.callbackAfter("-b", {"-a"});
+    parser.callbackAfter("-d", {"-c"});
+    parser.parallelCallbacks(4);
+
+    REQUIRE(parser.parse());
+    REQUIRE_THROWS_WITH(parser.waitForCallbacks(), "c");
+    REQUIRE(dependency_done);
+    REQUIRE(invoked == 3);
+
+    // nothing left to wait for
+    parser.waitForCallbacks();
+
+    // failures are only reported by an explicit wait
+    REQUIRE(parser.parse());
+    REQUIRE_NOTHROW(parser.parse());
+    REQUIRE_THROWS_WITH(parser.waitForCallbacks(), "c");
+}
+#endif
+
+TEST_CASE("test_prefetch")
+{
+    const char* path = "clapp_test_prefetch.dat";
+    {
+        std::ofstream file(path);
+        file << std::string(200000, 'x');
+    }
+
+    std::vector<std::string> arguments{"", "--input", path, "--model", path,
+                                       "--missing", "clapp_test_missing.dat"};
+    clapp::ArgumentParser parser(arguments);
+
+    auto& input =
+        parser.option<std::string>("--input").prefetch(clapp::Prefetch::Read);
+    auto& model = parser.option<std::string>("--model").prefetch();
+    parser.option<std::string>("--missing").prefetch(clapp::Prefetch::Read);
+
+    REQUIRE(parser.parse());
+    parser.waitForPrefetch();
+    std::remove(path);
+
+    REQUIRE(input.value() == path);
+    REQUIRE(model.value() == path);
+}
+
+TEST_CASE("test_mapped_file")
+{
+    const char* path = "clapp_test_mapped.txt";
+    {
+        std::ofstream file(path);
+        file << "mapped contents";
+    }
+
+    std::vector<std::string> arguments{"", "--input", path};
+    clapp::ArgumentParser parser(arguments);
+
+    auto& input = parser.option<clapp::MappedFile>("--input").required();
+
+    REQUIRE(parser.parse());
+    std::remove(path);
+    REQUIRE(input.value().view() == "mapped contents");
+    REQUIRE(input.value().path() == path);
+
+    std::vector<std::string> missing{"", "--input", "clapp_test_missing.txt"};
+    clapp::ArgumentParser missing_parser(missing);
+    missing_parser.option<clapp::MappedFile>("--input");
+
+    REQUIRE_THROWS_WITH(missing_parser.parse(),
+                        Catch::Contains("No such file or directory"));
+}
+
+TEST_CASE("test_process_command_line")
+{
+    const char buffer[] = "/usr/bin/tool\0--threads\0"
+                          "4\0--name\0\0";
+    clapp::ProcessCommandLine command_line;
+    command_line.assign(std::string_view(buffer, sizeof(buffer) - 1));
+    const auto& arguments = command_line.arguments();
+    REQUIRE(arguments.size() == 5);
+    REQUIRE(command_line.program() == "tool");
+    REQUIRE(arguments[4].empty());
+
+    clapp::ArgumentParser schema;
+    auto& threads = schema.option<int>("--threads").required();
+    auto& name = schema.option<std::string>("--name").defaultValue("anonymous");
+    int retries = 0;
+    schema.option<int>("--retries").defaultValue(3).store(retries);
+    bool invoked = false;
+    schema.option("--verbose").flag().callback([&](bool) { invoked = true; });
+
+    schema.validate(arguments.begin() + 1, arguments.end());
+    REQUIRE(threads.value() == 4);
+    REQUIRE(schema.specified("--name"));
+    REQUIRE_FALSE(schema.specified("--verbose"));
+
+    command_line.assign(std::string_view("tool\0--verbose\0", 15));
+    REQUIRE_THROWS_AS(schema.validate(command_line.arguments().begin() + 1,
+                                      command_line.arguments().end()),
+                      clapp::ArgumentParser::ArgumentParserException);
+    REQUIRE_FALSE(invoked);
+
+    // values of the previous command line do not leak into the next one
+    const char failing[] = "tool\0--retries\0"
+                           "5\0--name\0x\0";
+    command_line.assign(std::string_view(failing, sizeof(failing) - 1));
+    REQUIRE_THROWS_AS(schema.validate(command_line.arguments().begin() + 1,
+                                      command_line.arguments().end()),
+                      clapp::ArgumentParser::ArgumentParserException);
+    REQUIRE(retries == 5);
+    const char valid[] = "tool\0--threads\0"
+                         "2\0";
+    command_line.assign(std::string_view(valid, sizeof(valid) - 1));
+    schema.validate(command_line.arguments().begin() + 1,
+                    command_line.arguments().end());
+    REQUIRE(threads.value() == 2);
+    REQUIRE(name.value() == "anonymous");
+    REQUIRE(retries == 3);
+}
+
+TEST_CASE("test_scan_processes")
+{
+    clapp::ProcessCommandLine self;
+    if (!self.load(getpid()))
+    {
+        return;
+    }
+
+    clapp::ArgumentParser schema;
+    bool found = false;
+    auto matches = clapp::scanProcesses(
+        schema, self.program(),
+        [&](int pid, const clapp::ProcessCommandLine& command_line, bool)
+        { found = found || (pid == getpid() && command_line.program() ==
+                                                   self.program()); });
+    REQUIRE(matches >= 1);
+    REQUIRE(found);
+}
+
+TEST_CASE("test_validation_cache")
+{
+    const char* cache_path = "clapp_test_verdicts.bin";
+    const char* schema_path = "clapp_test_schema.txt";
+    std::remove(cache_path);
+    {
+        std::ofstream file(schema_path);
+        file << "v1";
+    }
+
+    int checks = 0;
+    auto run = [&](const std::string& value, bool inline_value = false)
+    {
+        std::vector<std::string> arguments{"", "--table", value};
+        if (inline_value)
+        {
+            arguments = {"", "--table=" + value};
+        }
+        clapp::ArgumentParser parser(arguments);
+        auto& table = parser.option<std::string>("--table").validate(
+            [&](const std::string& name)
+            {
+                ++checks;
+                return name != "invalid";
+            },
+            "is not a known table");
+        parser.validationCache(cache_path, {schema_path});
+        parser.parse();
+        return table.value();
+    };
+
+    REQUIRE(run("users") == "users");
+    REQUIRE(checks == 1);
+    REQUIRE(run("users") == "users");
+    REQUIRE(checks == 1);
+
+    REQUIRE_THROWS_AS(run("invalid"),
+                      clapp::ArgumentParser::ArgumentParserException);
+    REQUIRE_THROWS_AS(run("invalid"),
+                      clapp::ArgumentParser::ArgumentParserException);
+    REQUIRE(checks == 3);
+
+    {
+        std::ofstream file(schema_path, std::ios::app);
+        file << "v2";
+    }
+    REQUIRE(run("users") == "users");
+    REQUIRE(checks == 4);
+
+    // inline values that name a file are part of the key
+    const char* table_path = "clapp_test_table.txt";
+    {
+        std::ofstream file(table_path);
+        file << "a";
+    }
+    REQUIRE(run(table_path, true) == table_path);
+    REQUIRE(checks == 5);
+    REQUIRE(run(table_path, true) == table_path);
+    REQUIRE(checks == 5);
+    {
+        std::ofstream file(table_path, std::ios::app);
+        file << "b";
+    }
+    REQUIRE(run(table_path, true) == table_path);
+    REQUIRE(checks == 6);
+
+    std::remove(cache_path);
+    std::remove(schema_path);
+    std::remove(table_path);
+}
+
+TEST_CASE("test_choices_from_file")
+{
+    const char* path = "clapp_test_tenants.txt";
+    {
+        std::ofstream file(path);
+        file << "# tenants\n";
+        for (int i = 0; i < 1000; ++i)
+        {
+            file << "tenant-" << i << "\n";
+        }
+    }
+
+    std::vector<std::string> arguments{"", "--tenant", "tenant-42"};
+    clapp::ArgumentParser parser(arguments);
+    auto& tenant =
+        parser.option<std::string>("--tenant").choicesFromFile(path);
+
+    REQUIRE(parser.help().find("(one of the values in "
+                               "'clapp_test_tenants.txt')") !=
+            std::string::npos);
+    REQUIRE(parser.help().find("tenant-1") == std::string::npos);
+    REQUIRE(parser.parse());
+    REQUIRE(tenant.value() == "tenant-42");
+
+    std::vector<std::string> unknown{"", "--tenant", "tenant-1000"};
+    clapp::ArgumentParser unknown_parser(unknown);
+    unknown_parser.option<std::string>("--tenant").choicesFromFile(path);
+    REQUIRE_THROWS_AS(unknown_parser.parse(),
+                      clapp::ArgumentParser::ArgumentParserException);
+    std::remove(path);
+
+    clapp::ArgumentParser missing;
+    REQUIRE_THROWS_AS(
+        missing.option<std::string>("--tenant").choicesFromFile(path),
+        clapp::ArgumentParser::ArgumentParserException);
+}
+
+TEST_CASE("test_error_records")
+{
+    std::vector<std::string> arguments{"", "--count", "4", "--size", "big"};
+    clapp::ArgumentParser parser(arguments);
+    parser.option<int>("--count");
+    parser.option<int>("-s", "--size");
+
+    try
+    {
+        parser.parse();
+        FAIL("parse() did not throw");
+    }
+    catch (const clapp::ArgumentParser::ArgumentParserException& e)
+    {
+        REQUIRE(e.kind() == clapp::ErrorKind::InvalidValue);
+        REQUIRE(e.option() == 1);
+        REQUIRE(e.argument() == 2);
+        REQUIRE(e.value() == "big");
+        REQUIRE(std::string(e.what()) ==
+                "Invalid value 'big' for option '-s (--size)': Invalid "
+                "argument.");
+    }
+
+    std::vector<std::string> unknown{"", std::string(100, '-')};
+    clapp::ArgumentParser unknown_parser(unknown);
+    try
+    {
+        unknown_parser.parse();
+        FAIL("parse() did not throw");
+    }
+    catch (const clapp::ArgumentParser::ArgumentParserException& e)
+    {
+        REQUIRE(e.kind() == clapp::ErrorKind::UnknownOption);
+        REQUIRE(e.argument() == 0);
+        REQUIRE(std::string(e.what()) ==
+                "Unknown option '" + std::string(100, '-') + "'.");
+    }
+}
+
+#ifdef CLAPP_ENABLE_THREADS
+TEST_CASE("test_error_message_threads")
+{
+    std::exception_ptr error;
+    try
+    {
+        clapp::ArgumentParser parser;
+        parser.option<int>("-a");
+        parser.parse("tool -a x");
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    REQUIRE(error);
+
+    // copies share the record, what() formats the message only once
+    std::vector<const char*> messages(4);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < messages.size(); ++i)
+    {
+        threads.emplace_back(
+            [&, i]
+            {
+                try
+                {
+                    std::rethrow_exception(error);
+                }
+                catch (const clapp::ArgumentParser::ArgumentParserException& e)
+                {
+                    messages[i] = e.what();
+                }
+            });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    for (const auto* message : messages)
+    {
+        REQUIRE(message == messages.front());
+    }
+    REQUIRE(std::string(messages.front()).find("Invalid value 'x'") == 0);
+}
+#endif
+
+TEST_CASE("test_interned_names")
+{
+    using namespace clapp::literals;
+    char buffer[16] = "--buffer";
+    const char local[] = "--local";
+    std::string dynamic = "--dynamic";
+    const char* pointer = dynamic.c_str();
+
+    REQUIRE(clapp::OptionName("--literal"_static).is_static);
+    REQUIRE(clapp::OptionName(clapp::StaticText("--table")).is_static);
+    REQUIRE_FALSE(clapp::OptionName("--literal").is_static);
+    REQUIRE_FALSE(clapp::OptionName(local).is_static);
+    REQUIRE_FALSE(clapp::OptionName(buffer).is_static);
+    REQUIRE_FALSE(clapp::OptionName(pointer).is_static);
+    REQUIRE_FALSE(clapp::OptionName(dynamic).is_static);
+
+    std::vector<std::string> arguments{"", "--buffer", "1", "--dynamic", "2"};
+    clapp::ArgumentParser parser(arguments);
+    auto& from_buffer = parser.option<int>(buffer).description(
+        std::string("Description from a temporary."));
+    auto& from_string = parser.option<int>(dynamic);
+
+    // the parser keeps its own copies of dynamic names
+    std::strcpy(buffer, "--changed");
+    dynamic.assign("--changed-too");
+
+    REQUIRE(parser.parse());
+    REQUIRE(from_buffer.value() == 1);
+    REQUIRE(from_string.value() == 2);
+    REQUIRE(parser.help().find("Description from a temporary.") !=
+            std::string::npos);
+}
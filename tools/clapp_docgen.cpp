@@ -0,0 +1,150 @@
+// Renders the documentation of a tool's options at build time: the help text
+// as a header for ArgumentParser::prerenderedHelp(), a roff man page and
+// Markdown. Linked with the tool's source that defines clappDefineOptions(),
+// see cmake/ClappDocs.cmake.
+
+#include <clapp.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+void clappDefineOptions(clapp::ArgumentParser& parser);
+
+namespace
+{
+
+/**
+ * @brief C++ string literal of text, one literal per line.
+ *
+ */
+std::string literal(std::string_view text)
+{
+    std::string out = "\"";
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        char c = text[i];
+        switch (c)
+        {
+        case '"':
+            out.append("\\\"");
+            break;
+        case '\\':
+            out.append("\\\\");
+            break;
+        case '\n':
+            out.append(i + 1 < text.size() ? "\\n\"\n    \"" : "\\n");
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20 ||
+                static_cast<unsigned char>(c) >= 0x7f)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\%03o",
+                              static_cast<unsigned char>(c));
+                out.append(escaped);
+            }
+            else
+            {
+                out.push_back(c);
+            }
+            break;
+        }
+    }
+    out.append("\"");
+    return out;
+}
+
+bool writeFile(const std::string& path, const std::string& content)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << content;
+    file.close();
+    if (!file)
+    {
+        std::cerr << "Cannot write '" << path << "'." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    clapp::ArgumentParser generator(argc, argv);
+    generator.name("clapp_docgen")
+        .description("Renders the documentation of clapp options.");
+    generator.addHelp();
+    auto& program = generator.option<std::string>("--program")
+                        .argument("NAME")
+                        .required()
+                        .description("Program name shown in the usage line.");
+    auto& header = generator.option<std::string>("--header")
+                       .argument("FILE")
+                       .description("Header with the pre-rendered help.");
+    auto& name_space = generator.option<std::string>("--namespace")
+                           .argument("NAME")
+                           .defaultValue("clapp_docs")
+                           .description("Namespace of the header constants.");
+    auto& man = generator.option<std::string>("--man")
+                    .argument("FILE")
+                    .description("roff man page.");
+    auto& section = generator.option<int>("--section")
+                        .argument("N")
+                        .defaultValue(1)
+                        .description("Section of the man page.");
+    auto& markdown = generator.option<std::string>("--markdown")
+                         .argument("FILE")
+                         .description("Markdown document.");
+
+    try
+    {
+        if (!generator.parse())
+        {
+            return 0;
+        }
+    }
+    catch (const clapp::ArgumentParser::ArgumentParserException& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    clapp::ArgumentParser parser(std::vector<std::string>{program.value()});
+    clappDefineOptions(parser);
+
+    bool success = true;
+    if (!header.value().empty())
+    {
+        char fingerprint[32];
+        std::snprintf(
+            fingerprint, sizeof(fingerprint), "0x%016llxULL",
+            static_cast<unsigned long long>(parser.helpFingerprint()));
+        std::string content = "// Generated by clapp_docgen, do not edit.\n"
+                              "#pragma once\n\n"
+                              "#include <cstdint>\n"
+                              "#include <string_view>\n\n"
+                              "namespace " +
+                              name_space.value() +
+                              "\n{\n\n"
+                              "inline constexpr std::string_view help =\n"
+                              "    " +
+                              literal(parser.help()) +
+                              ";\n"
+                              "inline constexpr uint64_t fingerprint = " +
+                              fingerprint + ";\n\n} // namespace " +
+                              name_space.value() + "\n";
+        success = writeFile(header.value(), content) && success;
+    }
+    if (!man.value().empty())
+    {
+        success = writeFile(man.value(), parser.manPage(section.value())) &&
+                  success;
+    }
+    if (!markdown.value().empty())
+    {
+        success = writeFile(markdown.value(), parser.markdown()) && success;
+    }
+    return success ? 0 : 1;
+}